@@ -0,0 +1,19 @@
+// JLed user provided brightness curve demo. The curve is stored in flash on
+// AVR platforms.
+// Copyright 2017 by Jan Delgado. All rights reserved.
+// https://github.com/jandelgado/jled
+#include <jled.h>
+
+// a heartbeat like curve: two short pulses followed by a pause.
+const uint8_t kHeartbeat[] JLED_PROGMEM = {0, 255, 40, 0, 180, 20, 0, 0, 0};
+const JLedCurve kHeartbeatCurve = {kHeartbeat, sizeof(kHeartbeat)};
+
+// LED is connected to pin 9 (PWM capable) gpio
+JLed led = JLed(9).Curve(kHeartbeatCurve, 1200).Forever();
+
+void setup() {
+}
+
+void loop() {
+  led.Update();
+}
@@ -14,6 +14,7 @@ void setup() {
 }
 
 void loop() {
-    for (auto& led : leds) {led.Update();}
+    // update all LEDs with a single time tick.
+    UpdateAll(leds, sizeof(leds) / sizeof(leds[0]));
     delay(1);
 }
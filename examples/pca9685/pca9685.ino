@@ -0,0 +1,25 @@
+// JLed PCA9685 demo. Breathes LEDs connected to a PCA9685 16 channel PWM
+// driver on the I2C bus. All changed channels are sent in one burst per loop.
+// Copyright 2017 by Jan Delgado. All rights reserved.
+// https://github.com/jandelgado/jled
+#include <jled.h>
+#include <pca9685_writer.h>
+
+using Pca9685JLed = TJLed<Pca9685Writer<>>;
+
+JLedPca9685 pca;  // default I2C address 0x40
+
+Pca9685JLed leds[] = {
+    Pca9685JLed(Pca9685Writer<>(pca, 0)).Breathe(2000).Forever(),
+    Pca9685JLed(Pca9685Writer<>(pca, 1)).Breathe(2000).DelayBefore(500).Forever(),
+    Pca9685JLed(Pca9685Writer<>(pca, 2)).Breathe(2000).DelayBefore(1000).Forever(),
+    Pca9685JLed(Pca9685Writer<>(pca, 3)).Blink(500, 500).Forever()};
+
+void setup() {
+  pca.Begin();
+}
+
+void loop() {
+  UpdateAll(leds, sizeof(leds) / sizeof(leds[0]));
+  pca.Commit();
+}
@@ -0,0 +1,28 @@
+// JLed 74HC595 demo (AVR only). Breathes LEDs connected to two chained
+// 74HC595 shift registers (SER: MOSI, SRCLK: SCK, RCLK: pin 10), all driven by
+// a single timer interrupt.
+// Copyright 2017 by Jan Delgado. All rights reserved.
+// https://github.com/jandelgado/jled
+#include <jled.h>
+#include <shift_register_bam_writer.h>
+
+using BamWriter = ShiftRegisterBamWriter<2>;
+using BamJLed = TJLed<BamWriter>;
+
+JLedShiftRegisterBam<2> bam(10);
+
+BamJLed leds[] = {
+    BamJLed(BamWriter(bam, 0)).Breathe(2000).Forever(),
+    BamJLed(BamWriter(bam, 5)).Breathe(2000).DelayBefore(500).Forever(),
+    BamJLed(BamWriter(bam, 10)).Breathe(2000).DelayBefore(1000).Forever(),
+    BamJLed(BamWriter(bam, 15)).Breathe(2000).DelayBefore(1500).Forever()};
+
+JLED_BAM_ISR(bam.Isr());
+
+void setup() {
+  bam.Begin();
+}
+
+void loop() {
+  UpdateAll(leds, sizeof(leds) / sizeof(leds[0]));
+}
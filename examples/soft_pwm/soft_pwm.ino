@@ -0,0 +1,24 @@
+// JLed software PWM demo (AVR only). Breathes LEDs on pins without hardware
+// PWM support, all driven by a single timer interrupt.
+// Copyright 2017 by Jan Delgado. All rights reserved.
+// https://github.com/jandelgado/jled
+#include <jled.h>
+#include <soft_pwm_writer.h>
+
+using SoftJLed = TJLed<SoftPwmWriter>;
+
+SoftJLed leds[] = {
+    SoftJLed(2).Breathe(2000).Forever(),
+    SoftJLed(4).Breathe(2000).DelayBefore(500).Forever(),
+    SoftJLed(7).Breathe(2000).DelayBefore(1000).Forever(),
+    SoftJLed(8).Breathe(2000).DelayBefore(1500).Forever()};
+
+JLED_SOFT_PWM_ISR();
+
+void setup() {
+  JLedSoftPwm::Instance().Begin();
+}
+
+void loop() {
+  UpdateAll(leds, sizeof(leds) / sizeof(leds[0]));
+}
@@ -28,6 +28,8 @@ class ArduinoAnalogWriter /*: public AnalogWriter */ {
         ::pinMode(pin_, OUTPUT);
     }
     void analogWrite(uint8_t val) { ::analogWrite(pin_, val); }
+    // 16 bit value 0..65535, truncated to the 8 bit resolution of the PWM.
+    void analogWrite16(uint16_t val) { ::analogWrite(pin_, val >> 8); }
 
  private:
     uint8_t pin_;
@@ -0,0 +1,108 @@
+// Copyright (c) 2017 Jan Delgado <jdelgado[at]gmx.net>
+// https://github.com/jandelgado/jled
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+//
+#ifndef SRC_BATCHED_WRITER_H_
+#define SRC_BATCHED_WRITER_H_
+
+#include <Arduino.h>
+
+// Staged writes to multi channel LED drivers like the PCA9685 (I2C) or the
+// TLC5947 (SPI). Instead of a bus transaction per LED and update, the writers
+// of the LEDs stage their values in the shadow buffer of a JLedBatch, which
+// is sent to the device in a single burst by Commit(), e.g. once per loop:
+//
+//   MyDevice device;
+//   JLedBatch<MyDevice> batch(device);
+//   TJLed<BatchedWriter<MyDevice>> leds[] = {
+//       TJLed<BatchedWriter<MyDevice>>(BatchedWriter<MyDevice>(batch, 0))
+//           .Breathe(1000).Forever(), ...};
+//
+//   void loop() {
+//       UpdateAll(leds, sizeof(leds) / sizeof(leds[0]));
+//       batch.Commit();
+//   }
+//
+// The device D must provide:
+//
+//   static constexpr uint8_t kNumChannels;
+//   // send the 16 bit values of all kNumChannels channels to the device.
+//   // Only the channels first..last (inclusive) changed since the last call,
+//   // so a device with auto-increment addressing can just send those.
+//   void Transfer(const uint16_t* values, uint8_t first, uint8_t last);
+//
+template <typename D>
+class JLedBatch {
+ public:
+    static constexpr uint8_t kNumChannels = D::kNumChannels;
+
+    explicit JLedBatch(D& device) noexcept : device_(&device) {}
+
+    // stages the 16 bit value val of channel chan, which is sent to the
+    // device by the next Commit().
+    void Stage(uint8_t chan, uint16_t val) {
+        if (chan >= kNumChannels || values_[chan] == val) return;
+        values_[chan] = val;
+        if (chan < first_) first_ = chan;
+        if (chan > last_) last_ = chan;
+    }
+
+    // sends the staged values to the device, if any value changed since the
+    // last commit. Returns true if the device was written.
+    bool Commit() {
+        if (!IsDirty()) return false;
+        device_->Transfer(values_, first_, last_);
+        first_ = kNumChannels;
+        last_ = 0;
+        return true;
+    }
+
+    bool IsDirty() const { return first_ <= last_; }
+
+    // staged value of channel chan.
+    uint16_t Value(uint8_t chan) const { return values_[chan]; }
+
+ private:
+    D* device_;
+    uint16_t values_[kNumChannels] = {};
+    // range of channels changed since the last commit, empty if first_>last_
+    uint8_t first_ = kNumChannels;
+    uint8_t last_ = 0;
+};
+
+template <typename D>
+constexpr uint8_t JLedBatch<D>::kNumChannels;
+
+// Writer for TJLed, staging the brightness of channel chan in the given
+// JLedBatch. Supports JLed and JLed16.
+template <typename D>
+class BatchedWriter /*: public AnalogWriter */ {
+ public:
+    BatchedWriter(JLedBatch<D>& batch, uint8_t chan) noexcept
+        : batch_(&batch), chan_(chan) {}
+    void analogWrite(uint8_t val) { batch_->Stage(chan_, val * 257); }
+    void analogWrite16(uint16_t val) { batch_->Stage(chan_, val); }
+
+ private:
+    JLedBatch<D>* batch_;
+    uint8_t chan_;
+};
+
+#endif  // SRC_BATCHED_WRITER_H_
@@ -22,5 +22,10 @@
 #ifdef ESP32
 #include "esp32_analog_writer.h"  // NOLINT
 
-uint8_t Esp32AnalogWriter::nextChan_ = 0;
+constexpr uint8_t JLedLedcAllocator::kNumChannels;
+constexpr uint8_t JLedLedcAllocator::kNoChan;
+constexpr int Esp32AnalogWriter::kAutoSelectChan;
+
+JLedLedcAllocator Esp32AnalogWriter::allocator_;
+bool Esp32AnalogWriter::fadeInstalled_ = false;
 #endif
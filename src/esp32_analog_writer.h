@@ -23,9 +23,104 @@
 #define SRC_ESP32_ANALOG_WRITER_H_
 
 #include <Arduino.h>
+#include <driver/ledc.h>
+
+// Allocates the 16 ledc channels of the ESP32 to Esp32AnalogWriters. The
+// Arduino ledc functions bind the channels 2k and 2k+1 to the same timer
+// (4 timers per speed mode), which determines frequency and resolution of
+// both channels. A channel is therefore only handed out if its timer is
+// unused or already runs with the requested frequency and resolution.
+// Channels are reference counted, since writers are copied (e.g. into
+// TJLed), and are released when the last writer using them is destroyed.
+class JLedLedcAllocator {
+ public:
+    static constexpr uint8_t kNumChannels = 16;
+    static constexpr uint8_t kNoChan = 0xff;
+
+    // returns a free channel whose timer can be used with the given
+    // frequency and resolution, preferring timers already running with these
+    // settings, or kNoChan if all channels are in use or bound to timers
+    // with other settings.
+    uint8_t Allocate(uint8_t pin, uint16_t freq, uint8_t resolution) {
+        auto chan = kNoChan;
+        for (uint8_t c = 0; c < kNumChannels; c++) {
+            if (refs_[c] > 0) continue;
+            if (refs_[Sibling(c)] == 0) {
+                if (chan == kNoChan) chan = c;  // unused timer
+            } else if (timers_[Timer(c)].freq == freq &&
+                       timers_[Timer(c)].resolution == resolution) {
+                chan = c;  // shared timer
+                break;
+            }
+        }
+        return chan == kNoChan ? kNoChan : Claim(chan, pin, freq, resolution);
+    }
+
+    // uses the given channel, even if it is already in use. Returns kNoChan
+    // if chan is not a valid channel or its timer is in use with another
+    // frequency or resolution, which would change the output of the other
+    // channel.
+    uint8_t Claim(uint8_t chan, uint8_t pin, uint16_t freq,
+                  uint8_t resolution) {
+        if (chan >= kNumChannels) return kNoChan;
+        const auto& timer = timers_[Timer(chan)];
+        if (TimerInUse(chan) &&
+            (timer.freq != freq || timer.resolution != resolution)) {
+            return kNoChan;
+        }
+        refs_[chan]++;
+        pins_[chan] = pin;
+        timers_[Timer(chan)] = {freq, resolution};
+        return chan;
+    }
+
+    // adds a reference to the channel, e.g. when the writer is copied.
+    void Retain(uint8_t chan) { refs_[chan]++; }
+
+    // removes a reference to the channel. Returns true if the channel is
+    // free now.
+    bool Release(uint8_t chan) { return refs_[chan] > 0 && --refs_[chan] == 0; }
+
+    // true if a channel using the timer of chan is in use.
+    bool TimerInUse(uint8_t chan) const {
+        return refs_[chan] > 0 || refs_[Sibling(chan)] > 0;
+    }
+    // true if the timer of chan was already set up for another writer when
+    // chan was claimed.
+    bool TimerShared(uint8_t chan) const {
+        return refs_[chan] + refs_[Sibling(chan)] > 1;
+    }
+
+    // pin the channel was last claimed for.
+    uint8_t pin(uint8_t chan) const { return pins_[chan]; }
+    uint8_t refs(uint8_t chan) const { return refs_[chan]; }
+    uint8_t num_free() const {
+        uint8_t n = 0;
+        for (uint8_t c = 0; c < kNumChannels; c++) n += refs_[c] == 0;
+        return n;
+    }
+
+    // timer of the channel, as bound by the Arduino ledc functions.
+    static uint8_t Timer(uint8_t chan) {
+        return (chan >> 3) * 4 + ((chan >> 1) & 3);
+    }
+    // the other channel sharing the timer of chan.
+    static uint8_t Sibling(uint8_t chan) { return chan ^ 1; }
+
+ private:
+    struct TimerConfig {
+        uint16_t freq;
+        uint8_t resolution;
+    };
+    uint8_t refs_[kNumChannels] = {};
+    uint8_t pins_[kNumChannels] = {};
+    TimerConfig timers_[kNumChannels / 2] = {};
+};
 
 class Esp32AnalogWriter /*: public AnalogWriter */ {
     static constexpr auto kLedcTimer8Bit = 8;
+    static constexpr auto kLedcTimerMaxBits = 16;  // 16 bit pipeline
+    static constexpr uint32_t kLedcClock = 80000000;  // APB clock
 
  public:
     static constexpr auto kLedcMaxChan = 16;
@@ -33,25 +128,129 @@ class Esp32AnalogWriter /*: public AnalogWriter */ {
 
     // construct an ESP32 analog write object connected to the given pin.
     // chan specifies the EPS32 ledc channel to use. If set to kAutoSelectChan,
-    // the next available channel will be used, otherwise the specified one.
+    // a free channel is allocated (see JLedLedcAllocator), otherwise the
+    // specified one is used, unless its timer is in use with other settings.
+    // If no channel is available, valid() returns false and the writer does
+    // not output anything.
     // freq defines the ledc base frequency to be used (default: 5000 Hz).
+    // resolution is the ledc timer resolution in bits (8..16). Use a higher
+    // resolution together with a 16 bit brightness type (JLed16). Since the
+    // timer counts with the 80 MHz APB clock, frequency and resolution are a
+    // trade-off: the resolution is limited to MaxResolution(freq), e.g. 13
+    // bits at 5 kHz or 11 bits at 20 kHz, see resolution().
     explicit Esp32AnalogWriter(uint8_t pin, int chan = kAutoSelectChan,
-                               uint16_t freq = 5000) noexcept {
+                               uint16_t freq = 5000,
+                               uint8_t resolution = kLedcTimer8Bit) noexcept
+        : resolution_(ValidResolution(freq, resolution)) {
         // ESP32 framework lacks analogWrite() support, but behaviour can
         // be achievedd using LEDC channels.
         // https://docs.espressif.com/projects/esp-idf/en/latest/api-reference/peripherals/ledc.html
         chan_ = (chan == kAutoSelectChan)
-                    ? (Esp32AnalogWriter::nextChan_++) % kLedcMaxChan
-                    : chan;
-        ledcSetup(chan_, freq, kLedcTimer8Bit);
+                    ? allocator_.Allocate(pin, freq, resolution_)
+                    : allocator_.Claim(chan, pin, freq, resolution_);
+        if (!valid()) return;
+        // reconfiguring a timer shared with the same settings would only
+        // restart it, glitching the outputs of the other channel.
+        if (!allocator_.TimerShared(chan_)) {
+            ledcSetup(chan_, freq, resolution_);
+        }
         ledcAttachPin(pin, chan_);
     }
-    void analogWrite(uint8_t val) { ledcWrite(chan_, val); }
+    Esp32AnalogWriter(const Esp32AnalogWriter& other) noexcept
+        : chan_(other.chan_), resolution_(other.resolution_) {
+        if (valid()) allocator_.Retain(chan_);
+    }
+    Esp32AnalogWriter& operator=(const Esp32AnalogWriter& other) noexcept {
+        if (other.valid()) allocator_.Retain(other.chan_);
+        Release();
+        chan_ = other.chan_;
+        resolution_ = other.resolution_;
+        return *this;
+    }
+    // releases the channel if this is the last writer using it.
+    ~Esp32AnalogWriter() { Release(); }
+
+    void analogWrite(uint8_t val) {
+        if (!valid()) return;
+        ledcWrite(chan_, ScaleFrom8Bit(val, resolution_));
+    }
+    // 16 bit value 0..65535, reduced to the ledc timer resolution.
+    void analogWrite16(uint16_t val) {
+        if (!valid()) return;
+        ledcWrite(chan_, val >> (16 - resolution_));
+    }
+    // starts a hardware fade of the ledc peripheral from the current duty to
+    // the 16 bit value val, taking duration ms, and returns immediately. Used
+    // by TJLed::HardwareFade().
+    void analogFade16(uint16_t val, uint32_t duration) {
+        if (!valid()) return;
+#ifdef SOC_LEDC_SUPPORT_HS_MODE
+        // Arduino ledc channels 0..7 are the high speed channels, 8..15 the
+        // low speed channels of the ledc driver.
+        const auto mode =
+            chan_ < 8 ? LEDC_HIGH_SPEED_MODE : LEDC_LOW_SPEED_MODE;
+#else
+        // chips without high speed mode (e.g. ESP32-S2/S3/C3) only have the
+        // low speed channels, numbered like the Arduino ledc channels.
+        const auto mode = LEDC_LOW_SPEED_MODE;
+#endif
+        const auto chan = static_cast<ledc_channel_t>(chan_ & 7);
+        if (!fadeInstalled_) {
+            ledc_fade_func_install(0);
+            fadeInstalled_ = true;
+        }
+        ledc_set_fade_with_time(mode, chan, val >> (16 - resolution_),
+                                duration);
+        ledc_fade_start(mode, chan, LEDC_FADE_NO_WAIT);
+    }
+    // channel used, or JLedLedcAllocator::kNoChan if none was available.
     uint8_t chan() const { return chan_; }
+    bool valid() const { return chan_ != JLedLedcAllocator::kNoChan; }
+    // resolution actually used, i.e. the requested resolution limited to
+    // 8..MaxResolution(freq).
+    uint8_t resolution() const { return resolution_; }
+
+    // maximum timer resolution in bits at the given frequency, i.e. the
+    // largest number of bits with freq * 2^bits <= 80 MHz, limited to 16.
+    static uint8_t MaxResolution(uint16_t freq) {
+        uint8_t bits = kLedcTimer8Bit;
+        while (bits < kLedcTimerMaxBits &&
+               (static_cast<uint32_t>(freq) << (bits + 1)) <= kLedcClock) {
+            bits++;
+        }
+        return bits;
+    }
+
+    // resolution clamped to the range supported at the given frequency.
+    static uint8_t ValidResolution(uint16_t freq, uint8_t resolution) {
+        if (resolution < kLedcTimer8Bit) return kLedcTimer8Bit;
+        const auto max_bits = MaxResolution(freq);
+        return resolution > max_bits ? max_bits : resolution;
+    }
+
+    static const JLedLedcAllocator& allocator() { return allocator_; }
+
+ protected:
+    // scale an 8 bit value to the given resolution >= 8 bits by repeating
+    // the most significant bits, so that 0 -> 0 and 255 -> 2^resolution-1.
+    static uint32_t ScaleFrom8Bit(uint8_t val, uint8_t resolution) {
+        const uint32_t x = static_cast<uint32_t>(val) << (resolution - 8);
+        return x | (x >> 8);
+    }
 
  private:
-    static uint8_t nextChan_;
+    // detaches the pin from the channel when it is released, so that the
+    // channel can be reused for another pin.
+    void Release() {
+        if (valid() && allocator_.Release(chan_)) {
+            ledcDetachPin(allocator_.pin(chan_));
+        }
+    }
+
+    static JLedLedcAllocator allocator_;
+    static bool fadeInstalled_;
     uint8_t chan_;
+    uint8_t resolution_;
 };
 
 #endif  // SRC_ESP32_ANALOG_WRITER_H_
@@ -33,6 +33,10 @@ class Esp8266AnalogWriter /*: public AnalogWriter */ {
         // ESP8266 uses 10bit PWM range per default, scale value up
         ::analogWrite(pin_, Esp8266AnalogWriter::ScaleTo10Bit(val));
     }
+    // 16 bit value 0..65535, reduced to the native 10 bit PWM range.
+    void analogWrite16(uint16_t val) {
+        ::analogWrite(pin_, Esp8266AnalogWriter::Scale16To10Bit(val));
+    }
 
  protected:
     // scale an 8bit value to 10bit: 0 -> 0, ..., 255 -> 1023,
@@ -41,6 +45,9 @@ class Esp8266AnalogWriter /*: public AnalogWriter */ {
         return (x == 0) ? 0 : (x << 2) + 3;
     }
 
+    // scale a 16bit value to 10bit: 0 -> 0, ..., 65535 -> 1023
+    static uint16_t Scale16To10Bit(uint16_t x) { return x >> 6; }
+
  private:
     uint8_t pin_;
 };
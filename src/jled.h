@@ -23,6 +23,10 @@
 #define SRC_JLED_H_
 
 #include <Arduino.h>
+#include "jled_bank.h"       // NOLINT
+#include "jled_clock.h"      // NOLINT
+#include "jled_effects.h"    // NOLINT
+#include "jled_iteration.h"  // NOLINT
 
 // Non-blocking LED abstraction class.
 //
@@ -35,17 +39,24 @@
 //     led.Update();
 //   }
 //
+// T is the writer used to output the brightness values, E is the effect
+// policy, which determines how the brightness function is evaluated (see
+// JLedDynamicEffect and JLedStaticEffect). The brightness type of the
+// effect policy (uint8_t by default) is used throughout the LED. With a
+// uint16_t brightness (e.g. JLedDynamicEffectT<uint16_t>), the values are
+// passed to the writer's analogWrite16() method, see JLed16. C is the clock
+// policy (see jled_clock.h), which determines the unit and the width of all
+// durations, e.g. JLedMicrosClock for effects in us, see JLedMicros.
+template <typename T, typename E = JLedDynamicEffect,
+          typename C = JLedMillisClock>
+class TJLed : public JLedEffectsT<typename E::Brightness> {
+    using Effects = JLedEffectsT<typename E::Brightness>;
 
-template <typename T>
-class TJLed {
  public:
-    // a function f(t,period,param) that calculates the LEDs brightness for a
-    // given point in time and the given period. param is an optionally user
-    // provided parameter. t will always be in range [0..period-1].
-    // f(period-1,period,param) will be called last to calculate the final
-    // state of the LED.
-    using BrightnessEvalFunction = uint8_t (*)(uint32_t t, uint16_t period,
-                                               uintptr_t param);
+    using Brightness = typename E::Brightness;
+    using BrightnessEvalFunction = JLedBrightnessEvalFunctionT<Brightness>;
+    using Clock = C;
+    using Duration = typename C::Duration;
 
     TJLed() = delete;
     explicit TJLed(const T& port) noexcept : port_(port) {}
@@ -60,58 +71,76 @@ class TJLed {
     //        |<delay before>|<--period-->|<-delay after-> (time)
     //                       | func(t)    |
     //                       |<- num_repetitions times  ->
-    bool Update() {
-        if (!brightness_func_) {
+    bool Update() { return Update(Clock::Now()); }
+
+    // same as Update(), but uses the caller supplied point in time now (in
+    // ticks of the clock, e.g. ms as returned by millis()) instead of reading
+    // the clock. Use this to update a group of LEDs with one consistent time
+    // tick, see UpdateAll().
+    bool Update(uint32_t now) {
+        if (!effect_.IsActive()) {
             return false;
         }
-        const auto now = millis();
 
-        // no need to process updates twice during one time tick.
-        if (last_update_time_ == now) {
-            return true;
-        }
-
-        // last_update_time_ will be 0 on initialization, so this fails on
-        // first call to this method.
-        if (last_update_time_ == kTimeUndef) {
+        // all time stamps are only compared by their difference, so that
+        // the wrap around of the clock (e.g. of millis() after 49.7 days)
+        // needs no special treatment.
+        if (delay_before_ > 0) {
+            // wait until delay_before time is elapsed before actually doing
+            // anything. Meanwhile last_update_time_ holds the time at which
+            // the effect starts (or continues, see DelayBefore()).
+            const auto started = IsStarted();
+            if (!started && !IsInDelayAfterPhase()) {
+                SetInDelayAfterPhase(true);  // start time is set
+                last_update_time_ = now + delay_before_;
+            }
+            if (static_cast<int32_t>(now - last_update_time_) < 0) {
+                return true;
+            }
+            if (!started) SetInDelayAfterPhase(false);
+            delay_before_ = 0;
+        } else if (IsStarted()) {
+            // no need to process updates twice during one time tick.
+            if (last_update_time_ == now) return true;
+        } else {
+            // first call to this method.
             last_update_time_ = now;
-            time_start_ = now + delay_before_;
         }
+        // time elapsed since the last update, or since the effect started.
         const auto delta_time = now - last_update_time_;
         last_update_time_ = now;
-        // wait until delay_before time is elapsed before actually doing
-        // anything
-        if (delay_before_ > 0) {
-            delay_before_ =
-                max(static_cast<int64_t>(0),  // NOLINT
-                    static_cast<int64_t>(delay_before_) - delta_time);
-            if (delay_before_ > 0) return true;
-        }
-
-        if (!IsForever()) {
-            const auto time_end =
-                time_start_ +
-                (uint32_t)(period_ + delay_after_) * num_repetitions_;
 
-            if (now >= time_end) {
-                // make sure final value of t=period-1 is set
-                AnalogWrite(EvalBrightness(period_ - 1));
-                brightness_func_ = nullptr;
-                return false;
-            }
+        // t cycles in range [0..period+delay_after-1].
+        const auto last_t = CurrentTime();
+        auto t = last_t;
+        const auto new_iteration =
+            JLedIteration::Advance(&t, period_ + delay_after_, delta_time,
+                                   &iteration_, num_repetitions_);
+
+        if (JLedIteration::IsDone(iteration_, num_repetitions_)) {
+            // make sure final value of t=period-1 is set, rounded to the
+            // nearest 8 bit value when dithering.
+            SetDitherError(kDitherHalf);
+            // a hardware fade has reached its target by now.
+            SetFlags(FL_HW_FADING, false);
+            AnalogWrite(EvalBrightness(period_ - 1));
+            effect_.Stop();
+            return false;
         }
 
-        // t cycles in range [0..period+delay_after-1]
-        const auto t = (now - time_start_) % (period_ + delay_after_);
-
         if (t < period_) {
             SetInDelayAfterPhase(false);
-            AnalogWrite(EvalBrightness(t));
+            phase_ = t;
+            if (!FadeSegment(t, new_iteration ? kTimeUndef : last_t)) {
+                AnalogWrite(EvalBrightness(t));
+            }
         } else {
-            if (!IsInDelayAfterPhase()) {
+            phase_ = t - period_;
+            if (!IsInDelayAfterPhase() || IsDithering()) {
                 // when in delay after phase, just call AnalogWrite()
-                // once at the beginning.
+                // once at the beginning (unless dithering).
                 SetInDelayAfterPhase(true);
+                SetFlags(FL_HW_FADING, false);
                 AnalogWrite(EvalBrightness(period_ - 1));
             }
         }
@@ -119,112 +148,313 @@ class TJLed {
     }
 
     // turn LED on, respecting delay_before
-    TJLed<T>& On() {
+    TJLed& On() {
         period_ = 1;
-        return Init(&TJLed::OnFunc);
+        return Init<&TJLed::OnFunc>();
     }
 
     // turn LED off, respecting delay_before
-    TJLed<T>& Off() {
+    TJLed& Off() {
         period_ = 1;
-        return Init(&TJLed::OffFunc);
+        return Init<&TJLed::OffFunc>();
     }
 
     // turn LED on or off, calls On() / Off()
-    TJLed<T>& Set(bool on) { return on ? On() : Off(); }
+    TJLed& Set(bool on) { return on ? On() : Off(); }
 
     // Fade LED on
-    TJLed<T>& FadeOn(uint16_t duration) {
+    TJLed& FadeOn(Duration duration) {
         period_ = duration;
-        return Init(&TJLed::FadeOnFunc);
+        return Init<&TJLed::FadeOnFunc>();
     }
 
     // Fade LED off - acutally is just inverted version of FadeOn()
-    TJLed<T>& FadeOff(uint16_t duration) {
+    TJLed& FadeOff(Duration duration) {
         period_ = duration;
-        return Init(&TJLed::FadeOffFunc);
+        return Init<&TJLed::FadeOffFunc>();
     }
 
-    // Set effect to Breathe, with the given period time in ms.
-    TJLed<T>& Breathe(uint16_t period) {
+    // Set effect to Breathe, with the given period time.
+    TJLed& Breathe(Duration period) {
         period_ = period;
-        return Init(&TJLed::BreatheFunc);
+        return Init<&TJLed::BreatheFunc>();
     }
 
     // Set effect to Blink, with the given on- and off- duration values.
-    TJLed<T>& Blink(uint16_t duration_on, uint16_t duration_off) {
+    // With periods longer than 65535 ticks, the on-time is rounded to a
+    // multiple of 2^PeriodShift() ticks.
+    TJLed& Blink(Duration duration_on, Duration duration_off) {
         period_ = duration_on + duration_off;
-        effect_param_ = duration_on;
-        return Init(&TJLed::BlinkFunc);
+        // the brightness function sees t scaled, see EvalBrightness().
+        const auto shift = PeriodShift();
+        if (shift == 0) {
+            effect_param_ = duration_on;
+        } else {
+            const uint32_t on =
+                ((static_cast<uint32_t>(duration_on) >> (shift - 1)) + 1) >> 1;
+            effect_param_ = min(on, static_cast<uint32_t>(period_) >> shift);
+        }
+        return Init<&TJLed::BlinkFunc>();
+    }
+
+    // Set effect to the given brightness curve, which is stretched to the
+    // given period. The curve (and its table) must stay valid while the
+    // effect is in use.
+    TJLed& Curve(const JLedCurve& curve, Duration period) {
+        period_ = period;
+        effect_param_ = reinterpret_cast<uintptr_t>(&curve);
+        return Init<&TJLed::CurveFunc>();
     }
 
     // Use user provided function func as brightness function.
-    TJLed<T>& UserFunc(BrightnessEvalFunction func, uint16_t period,
-                       uintptr_t user_param = 0) {
+    TJLed& UserFunc(BrightnessEvalFunction func, Duration period,
+                    uintptr_t user_param = 0) {
+        effect_param_ = user_param;
+        period_ = period;
+        effect_.Set(func);
+        return Init();
+    }
+
+    // Use user provided function F as brightness function. In contrast to
+    // UserFunc(func, ...) this can also be used with JLedStaticEffect<F>.
+    template <BrightnessEvalFunction F>
+    TJLed& UserFunc(Duration period, uintptr_t user_param = 0) {
         effect_param_ = user_param;
         period_ = period;
-        return Init(func);
+        return Init<F>();
     }
 
     // set number of repetitions for effect.
-    TJLed<T>& Repeat(uint16_t num_repetitions) {
+    TJLed& Repeat(uint16_t num_repetitions) {
         num_repetitions_ = num_repetitions;
         return *this;
     }
 
     // repeat Forever
-    TJLed<T>& Forever() { return Repeat(kRepeatForever); }
+    TJLed& Forever() { return Repeat(kRepeatForever); }
     bool IsForever() const { return num_repetitions_ == kRepeatForever; }
 
     // Set amount of time to initially wait before effect starts. Time is
-    // relative to first call of Update() method and specified in ms.
-    TJLed<T>& DelayBefore(uint16_t delay_before) {
+    // relative to first call of Update() method and specified in ticks of
+    // the clock (ms by default). Must be less than 2^31 ticks. When called
+    // on a running effect, the effect pauses for the given time, counted
+    // from the last update.
+    TJLed& DelayBefore(Duration delay_before) {
         delay_before_ = delay_before;
+        if (IsStarted()) {
+            last_update_time_ += delay_before;  // time to continue
+        } else {
+            SetInDelayAfterPhase(false);  // start time set on next update
+        }
         return *this;
     }
 
-    // Set amount of time to wait in ms after each iteration.
-    TJLed<T>& DelayAfter(uint16_t delay_after) {
+    // Set amount of time to wait after each iteration.
+    TJLed& DelayAfter(Duration delay_after) {
         delay_after_ = delay_after;
         return *this;
     }
 
     // Invert effect. If set, every effect calculation will be inverted, i.e.
     // instead of a, 255-a will be used.
-    TJLed<T>& Invert() { return SetFlags(FL_INVERTED, true); }
+    TJLed& Invert() { return SetFlags(FL_INVERTED, true); }
     bool IsInverted() const { return GetFlag(FL_INVERTED); }
 
     // Set physical LED polarity to be low active. This inverts every signal
     // physically output to a pin.
-    TJLed<T>& LowActive() { return SetFlags(FL_LOW_ACTIVE, true); }
+    TJLed& LowActive() { return SetFlags(FL_LOW_ACTIVE, true); }
     bool IsLowActive() const { return GetFlag(FL_LOW_ACTIVE); }
 
+    // Correct the output for the non-linear perception of brightness by the
+    // human eye, using the CIE 1931 lightness curve (see JLedLightnessTable).
+    // Effect values, including inverted ones, are then treated as perceived
+    // brightness, e.g. a linear fade looks linear. The correction is applied
+    // before the LowActive() inversion of the physical output.
+    TJLed& Perceptual() {
+        Effects::EnableLightness();
+        return SetFlags(FL_PERCEPTUAL, true);
+    }
+    bool IsPerceptual() const { return GetFlag(FL_PERCEPTUAL); }
+
+    // Output the 16 bit brightness of a JLed16 with an 8 bit writer (i.e.
+    // analogWrite() instead of analogWrite16()), using temporal dithering
+    // (sigma-delta modulation): the output alternates between the two
+    // nearest 8 bit values on successive update ticks, so that its average
+    // has kDitherBits more bits of resolution. Update() must be called on
+    // every tick (e.g. every ms) while dithering. The dithering state is kept
+    // in the write cache, so it needs no additional memory.
+    template <typename U = Brightness>
+    TJLed& Dither() {
+        static_assert(sizeof(U) > 1,
+                      "Dither() requires a 16 bit brightness type (JLed16)");
+        return SetFlags(FL_DITHER, true);
+    }
+    bool IsDithered() const { return GetFlag(FL_DITHER); }
+
+    // Use the hardware fade engine of the writer (a writer method
+    // analogFade16(uint16_t val, uint32_t duration_ms), e.g. the ledc fade
+    // of the ESP32) for the fade, breathe and curve effects. These effects
+    // are composed of linear segments (see JLedFadeOnTable), so instead of
+    // writing a new value on every tick, each segment is programmed once as
+    // a hardware fade and NextUpdateTime() returns the end of the segment.
+    // Has no effect with writers without hardware fade or in combination
+    // with Perceptual() or Dither().
+    TJLed& HardwareFade() { return SetFlags(FL_HW_FADE, true); }
+    bool IsHardwareFade() const { return GetFlag(FL_HW_FADE); }
+
+    // Returns the earliest point in time (in ticks of the clock) at which the
+    // output of the LED can change and Update() needs to be called again. Only
+    // valid after a call to Update() returned true. Calling Update() earlier
+    // is allowed but will not change the output, so a scheduler can skip the
+    // LED (or the MCU can sleep) until the returned time is reached. Compare
+    // the time wrap-safe, e.g. static_cast<int32_t>(now - next) >= 0.
+    uint32_t NextUpdateTime() const {
+        // the start time of the effect, see Update().
+        if (delay_before_ > 0) return last_update_time_;
+        if (IsDithering()) return last_update_time_ + 1;
+
+        // the next change is always within the current iteration, so the
+        // end of the effect needs no special treatment.
+        const auto t = CurrentTime();
+        const auto iteration_start = last_update_time_ - t;
+        return iteration_start + ((t < period_) ? EvalNextChange(t)
+                                                : period_ + delay_after_);
+    }
+
     // Stop current effect and turn LED immeadiately off
     void Stop() {
         // Immediately turn LED off and stop effect.
-        brightness_func_ = nullptr;
+        effect_.Stop();
         AnalogWrite(0);
     }
 
  protected:
-    BrightnessEvalFunction brightness_func_ = nullptr;
     uintptr_t effect_param_ = 0;  // optional additional effect paramter.
 
-    // internal control of the LED, does not affect
-    // state and honors low_active_ flag
-    void AnalogWrite(uint8_t val) {
-        auto new_val = IsLowActive() ? kFullBrightness - val : val;
-        port_.analogWrite(new_val);
+    // internal control of the LED, does not affect state and honors the
+    // perceptual and low active flags. The last value written is cached, so
+    // that the writer is only called when the output actually changes (e.g.
+    // not during the on-phase of a blink), saving peripheral or bus accesses.
+    // While a hardware fade is running, the cache holds the target of the
+    // fade and not the current output, so the value is always written.
+    void AnalogWrite(Brightness val) {
+        if (GetFlag(FL_HW_FADING)) {
+            SetFlags(FL_HW_FADING | FL_LAST_VALUE_VALID, false);
+        }
+        const auto new_val = OutputValue(val);
+        if (IsDithering()) {
+            DitherWrite(new_val);
+            return;
+        }
+        if (GetFlag(FL_LAST_VALUE_VALID) && new_val == last_value_) return;
+        SetFlags(FL_LAST_VALUE_VALID, true);
+        last_value_ = new_val;
+        Write(new_val);
+    }
+
+    // maps the effect value val to the value physically output.
+    Brightness OutputValue(Brightness val) const {
+        if (IsPerceptual()) val = Effects::Lightness(val);
+        return IsLowActive() ? Effects::kFullBrightness - val : val;
+    }
+
+    // programs a hardware fade from t to the end of the linear segment of
+    // the effect containing t, see HardwareFade(). Nothing needs to be done
+    // while the fade of the segment of the last update at time last (in the
+    // same iteration, otherwise kTimeUndef) is running. Returns false if the
+    // value at t has to be written instead.
+    bool FadeSegment(uint32_t t, uint32_t last) {
+        if (!CanFadeInHardware()) return false;
+        const auto end = SegmentEnd(t);
+        // segments shorter than 1 ms can not be faded in hardware. A fade
+        // of a previous segment has (almost) reached its target, which is
+        // held by the cache.
+        if (end == 0 || end - t < Clock::kTicksPerMs) {
+            SetFlags(FL_HW_FADING, false);
+            return false;
+        }
+        const auto fading = GetFlag(FL_HW_FADING) && last != kTimeUndef;
+        if (fading && last < t && SegmentEnd(last) == end) return true;
+        // the hardware fade starts from the current output, which is only
+        // the start of the segment if the fade of the previous segment ran.
+        if (!fading) AnalogWrite(EvalBrightness(t));
+        const auto val = OutputValue(EvalBrightness(end));
+        AnalogFade(port_, val * (0xffff / Effects::kFullBrightness),
+                   (end - t) / Clock::kTicksPerMs, 0);
+        // the cache holds the final value of the fade, so that it is not
+        // written again at the end of the effect.
+        SetFlags(FL_LAST_VALUE_VALID | FL_HW_FADING, true);
+        last_value_ = val;
+        return true;
+    }
+
+    bool CanFadeInHardware() const {
+        return HasAnalogFade(static_cast<T*>(nullptr), 0) &&
+               IsHardwareFade() && !IsPerceptual() && !IsDithered();
+    }
+
+    // calls the hardware fade of the writer, if available (i.e. the
+    // overload with the int parameter is viable).
+    template <typename P>
+    static constexpr auto HasAnalogFade(P* port, int)
+        -> decltype(port->analogFade16(0, 0), bool()) {
+        return true;
+    }
+    template <typename P>
+    static constexpr bool HasAnalogFade(P*, long) {  // NOLINT
+        return false;
+    }
+    template <typename P>
+    static auto AnalogFade(P& port, uint16_t val, uint32_t duration, int)
+        -> decltype(port.analogFade16(val, duration), void()) {
+        port.analogFade16(val, duration);
+    }
+    template <typename P>
+    static void AnalogFade(P&, uint16_t, uint32_t, long) {}  // NOLINT
+
+    // first order sigma-delta modulation of the 16 bit value val to 8 bits.
+    // Only the upper kDitherBits of the lower byte are dithered, which keeps
+    // the dither pattern fast enough to avoid visible flicker. The 8 bit
+    // output is cached in the low byte of last_value_, the accumulated error
+    // in its high byte.
+    void DitherWrite(uint16_t val) {
+        const uint16_t x = val >> (8 - kDitherBits);
+        const uint8_t sum = (x & kDitherMask) + (last_value_ >> 8);
+        const uint16_t sum_out = (x >> kDitherBits) + (sum >> kDitherBits);
+        const uint8_t out = min(sum_out, static_cast<uint16_t>(255));
+        const bool changed =
+            !GetFlag(FL_LAST_VALUE_VALID) || out != (last_value_ & 0xff);
+        last_value_ = static_cast<uint16_t>((sum & kDitherMask) << 8) | out;
+        if (!changed) return;
+        SetFlags(FL_LAST_VALUE_VALID, true);
+        port_.analogWrite(out);
+    }
+
+    bool IsDithering() const { return Effects::kHighRes && IsDithered(); }
+    void SetDitherError(uint8_t err) {
+        if (IsDithering()) last_value_ = (err << 8) | (last_value_ & 0xff);
     }
 
-    TJLed<T>& Init(BrightnessEvalFunction func) {
-        brightness_func_ = func;
-        last_update_time_ = kTimeUndef;
-        time_start_ = kTimeUndef;
+    // pass the value to the writer, using its method for the brightness type.
+    void Write(uint8_t val) { port_.analogWrite(val); }
+    void Write(uint16_t val) { port_.analogWrite16(val); }
+
+    template <BrightnessEvalFunction F>
+    TJLed& Init() {
+        effect_.template Set<F>();
+        return Init();
+    }
+
+    TJLed& Init() {
+        // make sure a new effect always starts with a write
+        SetFlags(FL_LAST_VALUE_VALID | FL_HW_FADING, false);
+        SetInDelayAfterPhase(false);
+        phase_ = 0;
+        iteration_ = 0;
         return *this;
     }
 
-    TJLed<T>& SetFlags(uint8_t f, bool val) {
+    TJLed& SetFlags(uint8_t f, bool val) {
         if (val) {
             flags_ |= f;
         } else {
@@ -237,106 +467,196 @@ class TJLed {
     void SetInDelayAfterPhase(bool f) { SetFlags(FL_IN_DELAY_PHASE, f); }
     bool IsInDelayAfterPhase() const { return GetFlag(FL_IN_DELAY_PHASE); }
 
-    uint8_t EvalBrightness(uint32_t t) const {
-        const auto val = brightness_func_(t, period_, effect_param_);
-        return IsInverted() ? kFullBrightness - val : val;
-    }
-
-    // permanently turn LED on
-    static uint8_t OnFunc(uint32_t, uint16_t, uintptr_t) {
-        return kFullBrightness;
-    }
-
-    // permanently turn LED off
-    static uint8_t OffFunc(uint32_t, uint16_t, uintptr_t) {
-        return kZeroBrightness;
+    // the first update of an effect always writes, so the write cache tells
+    // whether the effect has started. Until then, FL_IN_DELAY_PHASE signals
+    // that last_update_time_ holds the start time after the delay before.
+    // For a started effect, delay_before_ > 0 signals that last_update_time_
+    // holds the time to continue, see DelayBefore().
+    bool IsStarted() const { return GetFlag(FL_LAST_VALUE_VALID); }
+
+    // time t in range [0..period+delay_after-1] of the last update, relative
+    // to the start of the current iteration.
+    uint32_t CurrentTime() const {
+        return IsInDelayAfterPhase() ? period_ + phase_ : phase_;
     }
 
-    // BlincFunc does one on-off cycle in the specified period. The effect_param
-    // specifies the time the effect is on.
-    static uint8_t BlinkFunc(uint32_t t, uint16_t period,
-                             uintptr_t effect_param) {
-        return (t < effect_param) ? kFullBrightness : kZeroBrightness;
+    // brightness functions take a 16 bit period. Longer periods (only
+    // possible with 32 bit durations) are scaled down together with t by
+    // PeriodShift() bits, which keeps the shape of the effect, since only the
+    // ratio t/period matters.
+    Brightness EvalBrightness(uint32_t t) const {
+        const auto shift = PeriodShift();
+        const auto val =
+            effect_.Eval(t >> shift, period_ >> shift, effect_param_);
+        return IsInverted() ? Effects::kFullBrightness - val : val;
     }
 
-    // fade LED on
-    // https://www.wolframalpha.com/input/?i=plot+(exp(sin((x-100%2F2.)*PI%2F100))-0.36787944)*108.0++x%3D0+to+100
-    // The fade-on func is an approximation of
-    //   y(x) = exp(sin((t-period/2.) * PI / period)) - 0.36787944) * 108.)
-    static uint8_t FadeOnFunc(uint32_t t, uint16_t period, uintptr_t) {
-        if (t + 1 >= period) return kFullBrightness;
-
-        // approximate by linear interpolation.
-        // scale t according to period to 0..255
-        t = ((t << 8) / period) & 0xff;
-        const auto i = (t >> 5);  // -> i will be in range 0 .. 7
-        const auto y0 = kFadeOnTable[i];
-        const auto y1 = kFadeOnTable[i + 1];
-        const auto x0 = i << 5;  // *32
-
-        // y(t) = mt+b, with m = dy/dx = (y1-y0)/32 = (y1-y0) >> 5
-        return (((t - x0) * (y1 - y0)) >> 5) + y0;
+    // returns the earliest point in time t' in range [t+1..period] at which
+    // the brightness function may return a value different from f(t). For
+    // the built-in effects this is derived from the effect's shape, for user
+    // provided functions we have to assume that every tick changes the value.
+    uint32_t EvalNextChange(uint32_t t) const {
+        if (GetFlag(FL_HW_FADING)) return SegmentEnd(t);
+        const auto func = effect_.func();
+        if (func == &TJLed::OnFunc || func == &TJLed::OffFunc) {
+            return period_;
+        }
+        if (func == &TJLed::BlinkFunc) {
+            const uint32_t on = effect_param_ << PeriodShift();
+            return (t < on) ? on : period_;
+        }
+        // the fades are not limited to the 256 steps of s with a high
+        // resolution brightness type, see Effects::Sample(), or a scaled
+        // period.
+        if (Effects::kHighRes || PeriodShift() > 0) return t + 1;
+        if (func == &TJLed::FadeOnFunc || func == &TJLed::CurveFunc) {
+            return Effects::FadeOnNextChange(t, period_);
+        }
+        if (func == &TJLed::FadeOffFunc) {
+            return Effects::FadeOffNextChange(t, period_);
+        }
+        if (func == &TJLed::BreatheFunc) {
+            return Effects::BreatheNextChange(t, period_);
+        }
+        return t + 1;
     }
 
-    // Fade LED off - inverse of FadeOnFunc()
-    static uint8_t FadeOffFunc(uint32_t t, uint16_t period, uintptr_t) {
-        return FadeOnFunc(period - t, period, 0);
+    // returns the end t' in range [t+1..period-1] of the linear segment
+    // containing t of the fade, breathe and curve effects, or 0 for other
+    // effects or at the end of the effect.
+    uint32_t SegmentEnd(uint32_t t) const {
+        const auto func = effect_.func();
+        const uint16_t n = JLedFadeOnTable<JLED_FADE_ON_TABLE_SIZE>::kSize - 1;
+        // the segments of a scaled period, see EvalBrightness().
+        const auto shift = PeriodShift();
+        const uint32_t ts = t >> shift;
+        const uint16_t period = period_ >> shift;
+        uint32_t end = 0;
+        if (func == &TJLed::FadeOnFunc) {
+            end = Effects::SegmentEnd(ts, period, n);
+        } else if (func == &TJLed::FadeOffFunc) {
+            end = Effects::ReverseSegmentEnd(ts, period, n);
+        } else if (func == &TJLed::BreatheFunc) {
+            end = Effects::BreatheSegmentEnd(ts, period, n);
+        } else if (func == &TJLed::CurveFunc) {
+            const auto curve =
+                reinterpret_cast<const JLedCurve*>(effect_param_);
+            end = Effects::SegmentEnd(ts, period, curve->size - 1);
+        }
+        end = min(end << shift, static_cast<uint32_t>(period_ - 1));
+        return end > t ? end : 0;
     }
 
-    // The breathe func is composed by fadein and fade-out with one each half
-    // period.  we approximate the following function:
-    //   y(x) = exp(sin((t-period/4.) * 2. * PI / period)) - 0.36787944) * 108.)
-    // idea see: http://sean.voisen.org/blog/2011/10/breathing-led-with-arduino/
-    // But we do it with integers only.
-    static uint8_t BreatheFunc(uint32_t t, uint16_t period, uintptr_t) {
-        if (t + 1 >= period) return kZeroBrightness;
-        const uint16_t periodh = period >> 1;
-        return t < periodh ? FadeOnFunc(t, periodh, 0)
-                           : FadeOffFunc(t - periodh, periodh, 0);
+    // number of bits by which t and the period are shifted right before
+    // the brightness function is evaluated, so that the period fits into 16
+    // bits. Always 0 with 16 bit durations.
+    uint8_t PeriodShift() const {
+        if (sizeof(Duration) <= sizeof(uint16_t)) return 0;
+        uint8_t shift = 0;
+        while ((static_cast<uint32_t>(period_) >> shift) > 0xffff) shift++;
+        return shift;
     }
 
  private:
-    // pre-calculated fade-on function. This table samples the function
-    //   y(x) =  exp(sin((t - period / 2.) * PI / period)) - 0.36787944) * 108.
-    // at x={0,32,...,256}. In FadeOnFunc() we us linear interpolation to
-    // approximate the original function (so we do not need fp-ops).
-    // fade-off and breath functions are all derived from fade-on, see below.
-    // (To save some additional bytes, we could place it in PROGMEM sometime)
-    static constexpr uint8_t kFadeOnTable[] = {0,   3,   13,  33, 68,
-                                               118, 179, 232, 255};
-    static constexpr uint16_t kRepeatForever = 65535;
+    static constexpr uint16_t kRepeatForever = JLedIteration::kRepeatForever;
     static constexpr uint32_t kTimeUndef = -1;
     static constexpr uint8_t FL_INVERTED = (1 << 0);
     static constexpr uint8_t FL_LOW_ACTIVE = (1 << 1);
     static constexpr uint8_t FL_IN_DELAY_PHASE = (1 << 2);
-    static constexpr uint8_t kFullBrightness = 255;
-    static constexpr uint8_t kZeroBrightness = 0;
-    T port_;
+    static constexpr uint8_t FL_LAST_VALUE_VALID = (1 << 3);
+    static constexpr uint8_t FL_PERCEPTUAL = (1 << 4);
+    static constexpr uint8_t FL_DITHER = (1 << 5);
+    static constexpr uint8_t FL_HW_FADE = (1 << 6);
+    static constexpr uint8_t FL_HW_FADING = (1 << 7);  // fade programmed
+    static constexpr uint8_t kDitherBits = 4;  // i.e. 12 bits resolution
+    static constexpr uint8_t kDitherMask = (1 << kDitherBits) - 1;
+    static constexpr uint8_t kDitherHalf = 1 << (kDitherBits - 1);
+    // members are ordered by size to avoid padding, see test "size of JLed"
+    // and the size budget below.
+    uint32_t last_update_time_ = 0;
+    Duration delay_before_ = 0;  // delay before the first effect starts
+    Duration delay_after_ = 0;   // delay after each repetition
+    Duration period_ = 0;
+    // position in the current iteration: t in period, or t-period in the
+    // delay after phase (see FL_IN_DELAY_PHASE), so a Duration is sufficient.
+    Duration phase_ = 0;
+    uint16_t num_repetitions_ = 1;
+    uint16_t iteration_ = 0;  // number of completed iterations
+    Brightness last_value_ = 0;  // last value written to port_
     uint8_t flags_ = 0;
+    T port_;
 
-    uint16_t num_repetitions_ = 1;
-    uint32_t last_update_time_ = kTimeUndef;
-    uint16_t delay_before_ = 0;  // delay before the first effect starts
-    uint16_t delay_after_ = 0;   // delay after each repetition
-    uint32_t time_start_ = kTimeUndef;
-    uint16_t period_ = 0;
+ protected:
+    // placed last, since JLedStaticEffect only needs a single byte.
+    E effect_;
 };
 
-template <typename T>
-constexpr uint8_t TJLed<T>::kFadeOnTable[];
-
+// update the n LEDs in array leds using the same point in time now, so all
+// LEDs see the same time tick. Returns true if at least one effect is still
+// active.
+template <typename L>
+bool UpdateAll(L* leds, size_t n, uint32_t now) {
+    auto active = false;
+    for (size_t i = 0; i < n; i++) {
+        active |= leds[i].Update(now);
+    }
+    return active;
+}
+
+// update the n LEDs in array leds, reading the clock of the LEDs only once.
+template <typename L>
+bool UpdateAll(L* leds, size_t n) {
+    return UpdateAll(leds, n, L::Clock::Now());
+}
+
+// JLed is the LED type of the platform. JLed16 uses a 16 bit brightness
+// pipeline, which is scaled to the native resolution of the writer at the
+// very end, e.g. 10 bits on the ESP8266, allowing smooth fades at low
+// brightness. JLedMicros uses micros() as time base, i.e. all durations are
+// in us, with 32 bit durations. JLedLong uses 32 bit durations in ms.
 #ifdef ESP32
 #include "esp32_analog_writer.h"  // NOLINT
 using JLed = TJLed<Esp32AnalogWriter>;
+template <JLedBrightnessEvalFunction F>
+using JLedStatic = TJLed<Esp32AnalogWriter, JLedStaticEffect<F>>;
+using JLed16 = TJLed<Esp32AnalogWriter, JLedDynamicEffectT<uint16_t>>;
+using JLedMicros =
+    TJLed<Esp32AnalogWriter, JLedDynamicEffect, JLedMicrosClock>;
+using JLedLong =
+    TJLed<Esp32AnalogWriter, JLedDynamicEffect, JLedLongMillisClock>;
 template class TJLed<Esp32AnalogWriter>;
 #elif ESP8266
 #include "esp8266_analog_writer.h"  // NOLINT
 using JLed = TJLed<Esp8266AnalogWriter>;
+template <JLedBrightnessEvalFunction F>
+using JLedStatic = TJLed<Esp8266AnalogWriter, JLedStaticEffect<F>>;
+using JLed16 = TJLed<Esp8266AnalogWriter, JLedDynamicEffectT<uint16_t>>;
+using JLedMicros =
+    TJLed<Esp8266AnalogWriter, JLedDynamicEffect, JLedMicrosClock>;
+using JLedLong =
+    TJLed<Esp8266AnalogWriter, JLedDynamicEffect, JLedLongMillisClock>;
 template class TJLed<Esp8266AnalogWriter>;
 #else
 #include "arduino_analog_writer.h"  // NOLINT
 using JLed = TJLed<ArduinoAnalogWriter>;
+template <JLedBrightnessEvalFunction F>
+using JLedStatic = TJLed<ArduinoAnalogWriter, JLedStaticEffect<F>>;
+using JLed16 = TJLed<ArduinoAnalogWriter, JLedDynamicEffectT<uint16_t>>;
+using JLedMicros =
+    TJLed<ArduinoAnalogWriter, JLedDynamicEffect, JLedMicrosClock>;
+using JLedLong =
+    TJLed<ArduinoAnalogWriter, JLedDynamicEffect, JLedLongMillisClock>;
 template class TJLed<ArduinoAnalogWriter>;
 #endif
 
+// size budget of a JLed object per platform. Many LEDs may be used on MCUs
+// with only little RAM (e.g. 2 KB on an ATmega328), so make sure that JLed
+// does not grow unnoticed. See also test "size of JLed". The ESP budget
+// assumes 32 bit pointers, the host tests of the ESP writers run on 64 bit.
+#if defined(__AVR__)
+static_assert(sizeof(JLed) <= 23, "JLed exceeds its size budget");
+#elif (defined(ESP32) || defined(ESP8266)) && UINTPTR_MAX == 0xffffffff
+static_assert(sizeof(JLed) <= 28, "JLed exceeds its size budget");
+#endif
+
 #endif  // SRC_JLED_H_
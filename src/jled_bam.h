@@ -0,0 +1,146 @@
+// Copyright (c) 2017 Jan Delgado <jdelgado[at]gmx.net>
+// https://github.com/jandelgado/jled
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+//
+#ifndef SRC_JLED_BAM_H_
+#define SRC_JLED_BAM_H_
+
+#include <Arduino.h>
+
+// types of the port output registers and pin masks used for direct port
+// manipulation. On AVR, portOutputRegister() and digitalPinToBitMask() are
+// statement expressions reading from flash, which GCC does not allow in a
+// decltype outside of functions.
+#ifdef __AVR__
+using JLedPortRegister = volatile uint8_t*;
+using JLedPortMask = uint8_t;
+#else
+using JLedPortRegister = decltype(portOutputRegister(0));
+using JLedPortMask = decltype(digitalPinToBitMask(0));
+#endif
+
+// Bit planes for bit angle modulation (BAM) of 8 bit brightness values. A BAM
+// period consists of 8 phases. In phase b, every output is on if bit b of its
+// brightness value is set, and phase b lasts 2^b time units. So a value v
+// keeps the output on for v of the 255 time units of a period. In contrast
+// to a classic software PWM, the outputs only change at the 8 phase
+// boundaries, independent of the number of outputs and their values.
+//
+// Outputs are grouped in M words of type W (e.g. the bits of a port register
+// or a shift register), and the planes store the word values of each phase,
+// so that outputting a phase costs one write per word. Values are changed in
+// the main context with Set(), while an ISR calls Next() to get the planes of
+// the next phase. Set() writes to a back buffer, which Next() swaps in at the
+// start of a period, so that a period never outputs a mix of old and new
+// bits of a value (e.g. 255 or 0 for a change from 127 to 128). This doubles
+// the memory used for the planes.
+template <typename W, uint8_t M>
+class JLedBamPlanes {
+ public:
+    static constexpr uint8_t kNumPhases = 8;
+
+    // set the output(s) given by mask in word m to the brightness val. The
+    // change is output from the start of the next period on.
+    void Set(uint8_t m, W mask, uint8_t val) {
+        // Next() does not swap the buffers while busy_ is set.
+        busy_ = true;
+        const uint8_t back = front_ ^ 1;
+        if (stale_) {
+            // the buffers were swapped, start from the values now output.
+            for (uint8_t b = 0; b < kNumPhases; b++) {
+                for (uint8_t i = 0; i < M; i++) {
+                    planes_[back][b][i] = planes_[front_][b][i];
+                }
+            }
+            stale_ = false;
+        }
+        for (uint8_t b = 0; b < kNumPhases; b++) {
+            if (val & (1 << b)) {
+                planes_[back][b][m] |= mask;
+            } else {
+                planes_[back][b][m] &= ~mask;
+            }
+        }
+        pending_ = true;
+        busy_ = false;
+    }
+
+    // returns the M words of phase b.
+    const volatile W* Plane(uint8_t b) const { return planes_[front_][b]; }
+
+    // advances to the next phase, returning its number. Phase b lasts 2^b
+    // time units, i.e. until Next() is called again. Changes made with Set()
+    // are swapped in before phase 0.
+    uint8_t Next() {
+        const auto b = phase_;
+        if (b == 0 && pending_ && !busy_) {
+            front_ ^= 1;
+            pending_ = false;
+            stale_ = true;
+        }
+        phase_ = (phase_ + 1) & (kNumPhases - 1);
+        return b;
+    }
+
+ private:
+    volatile W planes_[2][kNumPhases][M] = {};
+    volatile uint8_t front_ = 0;     // buffer read by the ISR
+    volatile bool busy_ = false;     // Set() in progress
+    volatile bool pending_ = false;  // back buffer has changes
+    volatile bool stale_ = false;    // back buffer older than front buffer
+    uint8_t phase_ = 0;
+};
+
+// Timer2 of AVR MCUs, which drives the BAM engines (JLedSoftPwm,
+// JLedShiftRegisterBam) in CTC mode. One time unit of the BAM is
+// prescaler / F_CPU, e.g. 16us with the default prescaler 256 at 16 MHz,
+// resulting in a BAM period of 255 * 16us (245 Hz). Every call of the ISR
+// must take less than one time unit. Timer2 is then no longer available for
+// tone() or hardware PWM on pins 3 and 11 (Uno).
+class JLedBamTimer {
+ public:
+    // clock select bits of TCCR2B for the prescaler
+    enum Prescaler : uint8_t { k64 = 4, k128 = 5, k256 = 6, k1024 = 7 };
+
+    // interrupt number of the timer for SPI.usingInterrupt(). The SPI library
+    // only knows the external interrupts, any other number makes it block
+    // all interrupts during the transactions of other SPI users.
+    static constexpr uint8_t kSpiInterrupt = 255;
+
+    static void Begin(Prescaler prescaler = k256) {
+#ifdef __AVR__
+        TCCR2A = _BV(WGM21);
+        TCCR2B = prescaler;
+        OCR2A = 0;
+        TIMSK2 |= _BV(OCIE2A);
+#endif
+    }
+};
+
+// defines the timer ISR calling the BAM engine's Isr() (given as expression
+// isr_call, e.g. JLED_BAM_ISR(bam.Isr())). Isr() returns the number of time
+// units until the next call. In CTC mode, the timer fires OCR2A+1 time units
+// after the last compare match.
+#ifdef __AVR__
+#define JLED_BAM_ISR(isr_call) \
+    ISR(TIMER2_COMPA_vect) { OCR2A = (isr_call) - 1; }
+#endif
+
+#endif  // SRC_JLED_BAM_H_
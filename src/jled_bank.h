@@ -0,0 +1,313 @@
+// Copyright (c) 2017 Jan Delgado <jdelgado[at]gmx.net>
+// https://github.com/jandelgado/jled
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+//
+#ifndef SRC_JLED_BANK_H_
+#define SRC_JLED_BANK_H_
+
+#include <Arduino.h>
+#include "jled_clock.h"      // NOLINT
+#include "jled_effects.h"    // NOLINT
+#include "jled_iteration.h"  // NOLINT
+
+// A bank of N LEDs, which are all updated with the same time tick in one
+// loop. In contrast to an array of TJLed objects, the state of the LEDs is
+// stored in parallel arrays (structure of arrays), so that the data needed
+// on every update is stored contiguously and data only needed during
+// configuration or delay before phase stays out of the way. Use this for
+// large numbers of LEDs. Each LED is configured using the well known fluent
+// interface via operator[], e.g.
+//
+//   JLedBank<3, ArduinoAnalogWriter> leds(3, 5, 6);
+//
+//   void setup() {
+//     leds[0].Breathe(2000).Forever();
+//     leds[1].Blink(500, 500).Repeat(10).DelayBefore(1000);
+//     leds[2].FadeOn(1000);
+//   }
+//
+//   void loop() {
+//     leds.Update();
+//   }
+//
+// C is the clock policy (see TJLed), which must use 16 bit durations.
+//
+// The iterations are tracked by JLedIteration like in TJLed. To keep the
+// per-LED state small, a bank differs from TJLed in the following points:
+//  * the remaining DelayBefore() is counted down per LED instead of storing
+//    a 32 bit start time, since the LEDs share one time stamp.
+//  * Dither(), HardwareFade() and NextUpdateTime() are not supported.
+//  * durations are limited to 16 bits, see the clock policy above.
+template <size_t N, typename T, typename E = JLedDynamicEffect,
+          typename C = JLedMillisClock>
+class JLedBank : public JLedEffectsT<typename E::Brightness> {
+    using Effects = JLedEffectsT<typename E::Brightness>;
+    static_assert(sizeof(typename C::Duration) == sizeof(uint16_t),
+                  "JLedBank requires a clock with 16 bit durations");
+
+ public:
+    using Brightness = typename E::Brightness;
+    using BrightnessEvalFunction = JLedBrightnessEvalFunctionT<Brightness>;
+    using Clock = C;
+
+    // reference to a single LED of the bank, providing the same fluent
+    // interface as TJLed to configure the LED.
+    class Ref {
+     public:
+        Ref(JLedBank* bank, size_t i) : bank_(bank), i_(i) {}
+
+        Ref& On() { return Init<&JLedBank::OnFunc>(1); }
+        Ref& Off() { return Init<&JLedBank::OffFunc>(1); }
+        Ref& Set(bool on) { return on ? On() : Off(); }
+        Ref& FadeOn(uint16_t duration) {
+            return Init<&JLedBank::FadeOnFunc>(duration);
+        }
+        Ref& FadeOff(uint16_t duration) {
+            return Init<&JLedBank::FadeOffFunc>(duration);
+        }
+        Ref& Breathe(uint16_t period) {
+            return Init<&JLedBank::BreatheFunc>(period);
+        }
+        Ref& Blink(uint16_t duration_on, uint16_t duration_off) {
+            bank_->effect_param_[i_] = duration_on;
+            return Init<&JLedBank::BlinkFunc>(duration_on + duration_off);
+        }
+        Ref& Curve(const JLedCurve& curve, uint16_t period) {
+            bank_->effect_param_[i_] = reinterpret_cast<uintptr_t>(&curve);
+            return Init<&JLedBank::CurveFunc>(period);
+        }
+        Ref& UserFunc(BrightnessEvalFunction func, uint16_t period,
+                      uintptr_t user_param = 0) {
+            bank_->effect_param_[i_] = user_param;
+            bank_->effect_[i_].Set(func);
+            return Init(period);
+        }
+        template <BrightnessEvalFunction F>
+        Ref& UserFunc(uint16_t period, uintptr_t user_param = 0) {
+            bank_->effect_param_[i_] = user_param;
+            return Init<F>(period);
+        }
+
+        Ref& Repeat(uint16_t num_repetitions) {
+            bank_->num_repetitions_[i_] = num_repetitions;
+            return *this;
+        }
+        Ref& Forever() { return Repeat(kRepeatForever); }
+        bool IsForever() const { return bank_->IsForever(i_); }
+        Ref& DelayBefore(uint16_t delay_before) {
+            bank_->delay_before_[i_] = delay_before;
+            return *this;
+        }
+        Ref& DelayAfter(uint16_t delay_after) {
+            bank_->delay_after_[i_] = delay_after;
+            return *this;
+        }
+        Ref& Invert() { return SetFlags(FL_INVERTED); }
+        bool IsInverted() const { return bank_->GetFlag(i_, FL_INVERTED); }
+        Ref& LowActive() { return SetFlags(FL_LOW_ACTIVE); }
+        bool IsLowActive() const { return bank_->GetFlag(i_, FL_LOW_ACTIVE); }
+        Ref& Perceptual() {
+            Effects::EnableLightness();
+            return SetFlags(FL_PERCEPTUAL);
+        }
+        bool IsPerceptual() const { return bank_->GetFlag(i_, FL_PERCEPTUAL); }
+        bool IsActive() const { return bank_->effect_[i_].IsActive(); }
+
+        // Stop current effect and turn LED immeadiately off
+        void Stop() {
+            bank_->effect_[i_].Stop();
+            bank_->AnalogWrite(i_, 0);
+        }
+
+     private:
+        template <BrightnessEvalFunction F>
+        Ref& Init(uint16_t period) {
+            bank_->effect_[i_].template Set<F>();
+            return Init(period);
+        }
+
+        Ref& Init(uint16_t period) {
+            bank_->period_[i_] = period;
+            bank_->SetFlags(i_, FL_LAST_VALUE_VALID | FL_IN_DELAY_PHASE |
+                                    FL_STARTED,
+                            false);
+            bank_->phase_[i_] = 0;
+            bank_->iteration_[i_] = 0;
+            return *this;
+        }
+
+        Ref& SetFlags(uint8_t f) {
+            bank_->SetFlags(i_, f, true);
+            return *this;
+        }
+
+        JLedBank* bank_;
+        size_t i_;
+    };
+
+    // construct a bank of N LEDs, one writer (or pin) for each LED, e.g.
+    // JLedBank<2, ArduinoAnalogWriter> leds(3, 5);
+    template <typename... P>
+    explicit JLedBank(P... ports) noexcept : ports_{T(ports)...} {
+        static_assert(sizeof...(P) == N, "one port per LED required");
+        for (size_t i = 0; i < N; i++) num_repetitions_[i] = 1;
+    }
+
+    Ref operator[](size_t i) { return Ref(this, i); }
+    static constexpr size_t size() { return N; }
+
+    // update all LEDs of the bank. Returns true if at least one effect is
+    // still active.
+    bool Update() { return Update(Clock::Now()); }
+
+    // same as Update(), but uses the caller supplied point in time now (in
+    // ticks of the clock) instead of reading the clock.
+    bool Update(uint32_t now) {
+        // the difference of the time stamps is wrap-safe. LEDs not started
+        // yet ignore the elapsed time, see UpdateLed(). Updates during the
+        // same time tick are processed too, so that LEDs configured within
+        // the tick start, the other LEDs see no elapsed time and are not
+        // written again.
+        const auto delta_time = now - last_update_time_;
+        last_update_time_ = now;
+
+        auto active = false;
+        for (size_t i = 0; i < N; i++) {
+            if (effect_[i].IsActive()) active |= UpdateLed(i, delta_time);
+        }
+        return active;
+    }
+
+    // returns true if at least one LED of the bank has an active effect.
+    bool IsActive() const {
+        for (size_t i = 0; i < N; i++) {
+            if (effect_[i].IsActive()) return true;
+        }
+        return false;
+    }
+
+ protected:
+    // see TJLed::Update()
+    bool UpdateLed(size_t i, uint32_t delta_time) {
+        // effects configured after the last update start now.
+        if (!GetFlag(i, FL_STARTED)) {
+            SetFlags(i, FL_STARTED, true);
+            delta_time = 0;
+        }
+
+        // the remaining delay is counted down, since the LEDs of the bank
+        // share a single time stamp.
+        if (delay_before_[i] > 0) {
+            if (delta_time < delay_before_[i]) {
+                delay_before_[i] -= delta_time;
+                return true;
+            }
+            delta_time -= delay_before_[i];
+            delay_before_[i] = 0;
+        }
+
+        const auto period = period_[i];
+        uint32_t t = (GetFlag(i, FL_IN_DELAY_PHASE) ? period : 0) + phase_[i];
+        JLedIteration::Advance(&t, period + delay_after_[i], delta_time,
+                               &iteration_[i], num_repetitions_[i]);
+
+        if (JLedIteration::IsDone(iteration_[i], num_repetitions_[i])) {
+            AnalogWrite(i, EvalBrightness(i, period - 1));
+            effect_[i].Stop();
+            return false;
+        }
+
+        if (t < period) {
+            SetFlags(i, FL_IN_DELAY_PHASE, false);
+            phase_[i] = t;
+            AnalogWrite(i, EvalBrightness(i, t));
+        } else {
+            phase_[i] = t - period;
+            if (!GetFlag(i, FL_IN_DELAY_PHASE)) {
+                SetFlags(i, FL_IN_DELAY_PHASE, true);
+                AnalogWrite(i, EvalBrightness(i, period - 1));
+            }
+        }
+        return true;
+    }
+
+    Brightness EvalBrightness(size_t i, uint32_t t) const {
+        const auto val = effect_[i].Eval(t, period_[i], effect_param_[i]);
+        return GetFlag(i, FL_INVERTED) ? Effects::kFullBrightness - val : val;
+    }
+
+    // see TJLed::AnalogWrite()
+    void AnalogWrite(size_t i, Brightness val) {
+        if (GetFlag(i, FL_PERCEPTUAL)) val = Effects::Lightness(val);
+        const Brightness new_val =
+            GetFlag(i, FL_LOW_ACTIVE) ? Effects::kFullBrightness - val : val;
+        if (GetFlag(i, FL_LAST_VALUE_VALID) && new_val == last_value_[i]) {
+            return;
+        }
+        SetFlags(i, FL_LAST_VALUE_VALID, true);
+        last_value_[i] = new_val;
+        Write(i, new_val);
+    }
+
+    // see TJLed::Write()
+    void Write(size_t i, uint8_t val) { ports_[i].analogWrite(val); }
+    void Write(size_t i, uint16_t val) { ports_[i].analogWrite16(val); }
+
+    void SetFlags(size_t i, uint8_t f, bool val) {
+        if (val) {
+            flags_[i] |= f;
+        } else {
+            flags_[i] &= ~f;
+        }
+    }
+    bool GetFlag(size_t i, uint8_t f) const { return (flags_[i] & f) != 0; }
+    bool IsForever(size_t i) const {
+        return num_repetitions_[i] == kRepeatForever;
+    }
+
+ private:
+    static constexpr uint16_t kRepeatForever = JLedIteration::kRepeatForever;
+    static constexpr uint8_t FL_INVERTED = (1 << 0);
+    static constexpr uint8_t FL_LOW_ACTIVE = (1 << 1);
+    static constexpr uint8_t FL_IN_DELAY_PHASE = (1 << 2);
+    static constexpr uint8_t FL_LAST_VALUE_VALID = (1 << 3);
+    static constexpr uint8_t FL_STARTED = (1 << 4);
+    static constexpr uint8_t FL_PERCEPTUAL = (1 << 5);
+
+    uint32_t last_update_time_ = 0;  // shared by all LEDs
+
+    // state needed on every update
+    E effect_[N];
+    uintptr_t effect_param_[N] = {};
+    uint16_t phase_[N] = {};  // see TJLed::phase_
+    uint16_t period_[N] = {};
+    uint16_t delay_after_[N] = {};
+    uint8_t flags_[N] = {};
+    Brightness last_value_[N] = {};
+
+    // state only needed during delay before phase or at end of an iteration
+    uint16_t delay_before_[N] = {};
+    uint16_t num_repetitions_[N];
+    uint16_t iteration_[N] = {};
+
+    T ports_[N];
+};
+
+#endif  // SRC_JLED_BANK_H_
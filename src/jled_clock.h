@@ -0,0 +1,108 @@
+// Copyright (c) 2017 Jan Delgado <jdelgado[at]gmx.net>
+// https://github.com/jandelgado/jled
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+//
+#ifndef SRC_JLED_CLOCK_H_
+#define SRC_JLED_CLOCK_H_
+
+#include <Arduino.h>
+
+// Clock policies of TJLed. A clock provides the current point in time in
+// ticks of the clock with Now(), the type used to store durations of effects
+// (Duration) and the number of ticks per ms (kTicksPerMs), which is needed
+// to convert durations for peripherals working in ms, e.g. hardware fades.
+// All durations passed to a TJLed (periods, delays) are in ticks of its
+// clock. The sum of period and delay after of an effect must fit into 32
+// bits. Periods longer than 65535 ticks (only possible with 32 bit
+// durations) are evaluated with a granularity of 2^k ticks, with k the
+// smallest shift making the period fit into 16 bits, e.g. 8 ticks for a
+// period of 300000 ticks.
+
+// ms as returned by millis(), with durations of type D. The default clock
+// JLedMillisClock uses 16 bit durations, limiting effects to 65 s.
+// JLedLongMillisClock uses 32 bit durations for effects lasting minutes to
+// days.
+template <typename D>
+struct JLedMillisClockT {
+    using Duration = D;
+    static constexpr uint16_t kTicksPerMs = 1;
+    static uint32_t Now() { return millis(); }
+};
+
+using JLedMillisClock = JLedMillisClockT<uint16_t>;
+using JLedLongMillisClock = JLedMillisClockT<uint32_t>;
+
+// us as returned by micros(), for high frequency or sub-millisecond effects,
+// e.g. a strobe with 200 us flashes. Durations are 32 bits wide, since with
+// 16 bits effects would be limited to 65 ms.
+struct JLedMicrosClock {
+    using Duration = uint32_t;
+    static constexpr uint16_t kTicksPerMs = 1000;
+    static uint32_t Now() { return micros(); }
+};
+
+// a clock caching the time of the source clock S, which is read only once
+// per frame with Tick(), e.g. at the beginning of loop(). All LEDs using the
+// frame clock see the same time without reading the source clock each.
+template <typename S>
+struct JLedFrameClockT {
+    using Duration = typename S::Duration;
+    static constexpr uint16_t kTicksPerMs = S::kTicksPerMs;
+    static uint32_t Now() { return now_; }
+    static void Tick() { now_ = S::Now(); }
+
+ private:
+    static uint32_t now_;
+};
+template <typename S>
+uint32_t JLedFrameClockT<S>::now_ = 0;
+
+using JLedFrameClock = JLedFrameClockT<JLedMillisClock>;
+
+// a clock derived from the user provided function F returning the time in
+// ms, e.g. read from a real time clock, which (in contrast to millis() on
+// most MCUs) keeps running while the MCU sleeps.
+template <uint32_t (*F)()>
+struct JLedRtcClock {
+    using Duration = uint16_t;
+    static constexpr uint16_t kTicksPerMs = 1;
+    static uint32_t Now() { return F(); }
+};
+
+// a manually stepped clock with durations of type D, e.g. to simulate
+// effects on a host much faster than real time. The time only changes with
+// Set() and Step().
+template <typename D = uint16_t>
+struct JLedSteppedClockT {
+    using Duration = D;
+    static constexpr uint16_t kTicksPerMs = 1;
+    static uint32_t Now() { return now_; }
+    static void Set(uint32_t now) { now_ = now; }
+    static void Step(uint32_t delta) { now_ += delta; }
+
+ private:
+    static uint32_t now_;
+};
+template <typename D>
+uint32_t JLedSteppedClockT<D>::now_ = 0;
+
+using JLedSteppedClock = JLedSteppedClockT<>;
+
+#endif  // SRC_JLED_CLOCK_H_
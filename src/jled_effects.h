@@ -0,0 +1,505 @@
+// Copyright (c) 2017 Jan Delgado <jdelgado[at]gmx.net>
+// https://github.com/jandelgado/jled
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+//
+#ifndef SRC_JLED_EFFECTS_H_
+#define SRC_JLED_EFFECTS_H_
+
+#include <Arduino.h>
+
+#ifdef __AVR__
+#include <avr/pgmspace.h>
+// tables declared with JLED_PROGMEM are stored in flash on AVR, where RAM is
+// scarce, and in normal memory on all other platforms. Use JLedReadTable()
+// to access them.
+#define JLED_PROGMEM PROGMEM
+#else
+#define JLED_PROGMEM
+#endif
+
+// returns entry i of a table declared with JLED_PROGMEM.
+inline uint8_t JLedReadTable(const uint8_t* table, uint16_t i) {
+#ifdef __AVR__
+    return pgm_read_byte(table + i);
+#else
+    return table[i];
+#endif
+}
+
+inline uint16_t JLedReadTable(const uint16_t* table, uint16_t i) {
+#ifdef __AVR__
+    return pgm_read_word(table + i);
+#else
+    return table[i];
+#endif
+}
+
+// A brightness curve defined by 2 <= size <= 257 values, which are
+// distributed equidistantly over the period of the effect (see
+// TJLed::Curve()). With 8 bit brightness, the curve is sampled at t scaled
+// to 0..255, so a table with more than 257 values would silently skip
+// entries. The table must be declared with JLED_PROGMEM, since it is always
+// read from flash on AVR (see JLedReadTable()), e.g.
+//   const uint8_t kTable[] JLED_PROGMEM = {0, 10, 50, 255};
+//   const JLedCurve kCurve = {kTable, sizeof(kTable)};
+struct JLedCurve {
+    const uint8_t* table;
+    uint16_t size;
+};
+
+// JLedMakeIndices<N>::Type is JLedIndices<0, 1, ..., N-1>, used to generate
+// tables with N entries at compile time.
+template <uint16_t... I>
+struct JLedIndices {};
+template <uint16_t N, uint16_t... I>
+struct JLedMakeIndices {
+    using Type = typename JLedMakeIndices<N - 1, N - 1, I...>::Type;
+};
+template <uint16_t... I>
+struct JLedMakeIndices<0, I...> {
+    using Type = JLedIndices<I...>;
+};
+
+// Generates the fade-on curve
+//   y(x) = (exp(sin((x - 1/2) * PI)) - 0.36787944) * 108,  x in [0..1]
+// sampled at N equidistant points at compile time, so the resolution of the
+// curve can be traded for flash. N must be 2^k+1 for k=3..8, i.e. one of 9,
+// 17, 33, 65, 129 or 257. With 257 points, every value of t scaled to 0..255
+// has its own entry and no interpolation is needed at runtime. Values are
+// rounded, except for N=9, which keeps the truncated values of the original
+// table of the built-in effects. The last value is set to full brightness.
+// Example: led.Curve(JLedFadeOnTable<65>::Curve(), 2000);
+template <uint16_t N>
+class JLedFadeOnTable {
+    static_assert(N == 9 || N == 17 || N == 33 || N == 65 || N == 129 ||
+                      N == 257,
+                  "N must be one of 9, 17, 33, 65, 129, 257");
+
+ public:
+    static constexpr uint16_t kSize = N;
+
+    // returns the table, stored with JLED_PROGMEM
+    static const uint8_t* Table() { return Curve().table; }
+
+    static const JLedCurve& Curve() {
+        return Curve(typename JLedMakeIndices<N>::Type());
+    }
+
+    // value of the curve at x, evaluated with double precision
+    static constexpr double Eval(double x) {
+        return (Exp(Sin((x - 0.5) * PI)) - 0.36787944) * 108.;
+    }
+
+    static constexpr uint8_t Value(uint16_t i) {
+        return (i + 1 == N) ? 255
+                            : static_cast<uint8_t>(Eval(i / (N - 1.)) +
+                                                   (N == 9 ? 0. : 0.5));
+    }
+
+ private:
+    template <uint16_t... I>
+    static const JLedCurve& Curve(JLedIndices<I...>) {
+        static constexpr uint8_t kTable[] JLED_PROGMEM = {Value(I)...};
+        static constexpr JLedCurve kCurve = {kTable, N};
+        return kCurve;
+    }
+
+    // Taylor series of sin(x) and exp(x), sufficient for |x| <= PI/2
+    static constexpr double SinSeries(double x2, double term, int k) {
+        return (k > 12) ? term
+                        : term + SinSeries(x2,
+                                           -term * x2 / ((2 * k + 2) *
+                                                         (2 * k + 3)),
+                                           k + 1);
+    }
+    static constexpr double Sin(double x) { return SinSeries(x * x, x, 0); }
+    static constexpr double ExpSeries(double x, double term, int k) {
+        return (k > 24) ? term
+                        : term + ExpSeries(x, term * x / (k + 1), k + 1);
+    }
+    static constexpr double Exp(double x) { return ExpSeries(x, 1., 0); }
+};
+
+template <uint16_t N>
+constexpr uint16_t JLedFadeOnTable<N>::kSize;
+
+// Maps a perceived brightness (lightness) 0..255 to the physical brightness
+// (duty cycle) 0..255 according to the CIE 1931 lightness formula
+//   Y = (L <= 8) ? L / 903.3 : ((L + 16) / 116)^3,  L = 100 * v / 255
+// The human eye perceives brightness roughly logarithmically, so linear
+// effects look too bright most of the time without this correction. The
+// table is generated at compile time and stored with JLED_PROGMEM, so a
+// correction costs a single table lookup. The table (256 bytes, 514 bytes for
+// Lookup16()) is only linked into programs using TJLed::Perceptual().
+// Lookup16() is the 16 bit version used by high resolution LEDs, which
+// interpolates a 257 entry table of 16 bit values.
+class JLedLightnessTable {
+ public:
+    static uint8_t Lookup(uint8_t val) {
+        return JLedReadTable(Table(typename JLedMakeIndices<256>::Type()),
+                             val);
+    }
+
+    static uint16_t Lookup16(uint16_t val) {
+        if (val == 0xffff) return val;
+        const auto table = Table16(typename JLedMakeIndices<257>::Type());
+        const int32_t y0 = JLedReadTable(table, val >> 8);
+        const int32_t y1 = JLedReadTable(table, (val >> 8) + 1);
+        return y0 + (((y1 - y0) * (val & 0xff)) >> 8);
+    }
+
+    static constexpr uint8_t Value(uint8_t val) {
+        return static_cast<uint8_t>(Luminance(100. * val / 255.) * 255. + .5);
+    }
+
+    // entry i of the 16 bit table, i.e. the value at position i * 256.
+    static constexpr uint16_t Value16(uint16_t i) {
+        return (i >= 256) ? 0xffff
+                          : static_cast<uint16_t>(
+                                Luminance(100. * i * 256. / 65535.) *
+                                    65535. +
+                                .5);
+    }
+
+ private:
+    template <uint16_t... I>
+    static const uint8_t* Table(JLedIndices<I...>) {
+        static constexpr uint8_t kTable[] JLED_PROGMEM = {Value(I)...};
+        return kTable;
+    }
+
+    template <uint16_t... I>
+    static const uint16_t* Table16(JLedIndices<I...>) {
+        static constexpr uint16_t kTable[] JLED_PROGMEM = {Value16(I)...};
+        return kTable;
+    }
+
+    static constexpr double Cube(double x) { return x * x * x; }
+    static constexpr double Luminance(double l) {
+        return (l <= 8.) ? l / 903.3 : Cube((l + 16.) / 116.);
+    }
+};
+
+// number of points of the fade-on curve used by the built-in FadeOn(),
+// FadeOff() and Breathe() effects, see JLedFadeOnTable.
+#ifndef JLED_FADE_ON_TABLE_SIZE
+#define JLED_FADE_ON_TABLE_SIZE 9
+#endif
+
+// a function f(t,period,param) that calculates the LEDs brightness for a
+// given point in time and the given period. param is an optionally user
+// provided parameter. t will always be in range [0..period-1].
+// f(period-1,period,param) will be called last to calculate the final
+// state of the LED. B is the brightness type, i.e. uint8_t (0..255) or
+// uint16_t (0..65535) for a high resolution brightness pipeline.
+template <typename B>
+using JLedBrightnessEvalFunctionT = B (*)(uint32_t t, uint16_t period,
+                                          uintptr_t param);
+using JLedBrightnessEvalFunction = JLedBrightnessEvalFunctionT<uint8_t>;
+
+// The built-in brightness functions of JLed, calculating values of the
+// brightness type B. They are public, so they can be used as parameter of
+// JLedStaticEffect.
+template <typename B>
+class JLedEffectsT {
+    static_assert(sizeof(B) <= 2 && static_cast<B>(-1) > 0,
+                  "brightness type must be uint8_t or uint16_t");
+
+ public:
+    using Brightness = B;
+
+    // permanently turn LED on
+    static B OnFunc(uint32_t, uint16_t, uintptr_t) { return kFullBrightness; }
+
+    // permanently turn LED off
+    static B OffFunc(uint32_t, uint16_t, uintptr_t) { return kZeroBrightness; }
+
+    // BlincFunc does one on-off cycle in the specified period. The effect_param
+    // specifies the time the effect is on.
+    static B BlinkFunc(uint32_t t, uint16_t period, uintptr_t effect_param) {
+        return (t < effect_param) ? kFullBrightness : kZeroBrightness;
+    }
+
+    // fade LED on
+    // https://www.wolframalpha.com/input/?i=plot+(exp(sin((x-100%2F2.)*PI%2F100))-0.36787944)*108.0++x%3D0+to+100
+    // The fade-on func is an approximation of
+    //   y(x) = exp(sin((t-period/2.) * PI / period)) - 0.36787944) * 108.)
+    static B FadeOnFunc(uint32_t t, uint16_t period, uintptr_t) {
+        if (t + 1 >= period) return kFullBrightness;
+
+        // approximate by linear interpolation of the pre-calculated curve
+        // (so we do not need fp-ops), see JLedFadeOnTable. Fade-off and
+        // breathe functions are derived from fade-on.
+        using Table = JLedFadeOnTable<JLED_FADE_ON_TABLE_SIZE>;
+        return Sample(Table::Table(), Table::kSize, t, period);
+    }
+
+    // Fade LED off - inverse of FadeOnFunc()
+    static B FadeOffFunc(uint32_t t, uint16_t period, uintptr_t) {
+        return FadeOnFunc(period - t, period, 0);
+    }
+
+    // The breathe func is composed by fadein and fade-out with one each half
+    // period.  we approximate the following function:
+    //   y(x) = exp(sin((t-period/4.) * 2. * PI / period)) - 0.36787944) * 108.)
+    // idea see: http://sean.voisen.org/blog/2011/10/breathing-led-with-arduino/
+    // But we do it with integers only.
+    static B BreatheFunc(uint32_t t, uint16_t period, uintptr_t) {
+        if (t + 1 >= period) return kZeroBrightness;
+        const uint16_t periodh = period >> 1;
+        return t < periodh ? FadeOnFunc(t, periodh, 0)
+                           : FadeOffFunc(t - periodh, periodh, 0);
+    }
+
+    // brightness curve defined by a table of values, which is stretched to
+    // the period. The effect_param points to the JLedCurve to use.
+    static B CurveFunc(uint32_t t, uint16_t period, uintptr_t effect_param) {
+        const auto curve = reinterpret_cast<const JLedCurve*>(effect_param);
+        if (t + 1 >= period) {
+            return FromByte(JLedReadTable(curve->table, curve->size - 1));
+        }
+        return Sample(curve->table, curve->size, t, period);
+    }
+
+ protected:
+    static constexpr B kFullBrightness = static_cast<B>(-1);
+    static constexpr B kZeroBrightness = 0;
+    // true if B has more than 8 bits. Branches on kHighRes are resolved at
+    // compile time, so 8 bit LEDs do not pay for the high resolution code.
+    static constexpr bool kHighRes = sizeof(B) > 1;
+
+    // scales an 8 bit value (e.g. of a table) to B, i.e. 255 to
+    // kFullBrightness.
+    static B FromByte(uint8_t val) {
+        return static_cast<B>(val * (kFullBrightness / 255));
+    }
+
+    // maps a perceived brightness to the physical brightness, see
+    // JLedLightnessTable. Only valid after EnableLightness().
+    static B Lightness(B val) { return lightness_(val); }
+
+    // makes Lightness() available, called by Perceptual(). The lightness
+    // table is only referenced from here, so that it is not linked into
+    // programs which never call Perceptual().
+    static void EnableLightness() { lightness_ = &LightnessLookup; }
+
+    // linear interpolation of the size values of table at position t/period,
+    // in the resolution of B.
+    static B Sample(const uint8_t* table, uint16_t size, uint32_t t,
+                    uint16_t period) {
+        return kHighRes ? Interpolate16(table, size, ScaleToWord(t, period))
+                        : Interpolate(table, size, ScaleToByte(t, period));
+    }
+
+    // returns (t << 8) / period, i.e. t scaled to 0..255, for t < period.
+    static uint8_t ScaleToByte(uint32_t t, uint16_t period) {
+#ifdef __AVR__
+        return ScaleToByteShiftSubtract(t, period);
+#else
+        return (t << 8) / period;
+#endif
+    }
+
+    // Since the quotient of ScaleToByte() has only 8 bits, 8 steps of a
+    // shift-and-subtract division are sufficient. This is much cheaper than
+    // the generic 32 bit division on MCUs without hardware divider (AVR),
+    // but slower than a hardware divide.
+    static uint8_t ScaleToByteShiftSubtract(uint32_t t, uint16_t period) {
+        uint8_t s = 0;
+        for (auto i = 0; i < 8; i++) {
+            t <<= 1;
+            s <<= 1;
+            if (t >= period) {
+                t -= period;
+                s |= 1;
+            }
+        }
+        return s;
+    }
+
+    // returns (t << 16) / period, i.e. t scaled to 0..65535, for t < period.
+    static uint16_t ScaleToWord(uint32_t t, uint16_t period) {
+        return (t << 16) / period;
+    }
+
+    // linear interpolation of the size values of table at position s/256,
+    // with s in range 0..255. The table is read using JLedReadTable().
+    static uint8_t Interpolate(const uint8_t* table, uint16_t size,
+                               uint8_t s) {
+        // a table with 257 entries has a value for every s.
+        if (size == 257) return JLedReadTable(table, s);
+        const uint32_t x = static_cast<uint32_t>(s) * (size - 1);
+        const auto i = x >> 8;
+        const int16_t frac = x & 0xff;
+        const int16_t y0 = JLedReadTable(table, i);
+        const int16_t y1 = JLedReadTable(table, i + 1);
+
+        // y(x) = y0 + (y1-y0) * frac / 256
+        return y0 + ((static_cast<int32_t>(y1 - y0) * frac) >> 8);
+    }
+
+    // same as Interpolate(), but at position s/65536 with s in range
+    // 0..65535, returning the table values scaled to 0..65535. In contrast
+    // to the 8 bit version, the interpolated values are not truncated to
+    // the 8 bit steps of the table.
+    static uint16_t Interpolate16(const uint8_t* table, uint16_t size,
+                                  uint16_t s) {
+        const uint32_t x = static_cast<uint32_t>(s) * (size - 1);
+        const auto i = x >> 16;
+        const int32_t frac = (x >> 8) & 0xff;
+        const int32_t y0 = JLedReadTable(table, i) * 257;
+        const int32_t y1 = JLedReadTable(table, i + 1) * 257;
+        return y0 + (((y1 - y0) * frac) >> 8);
+    }
+
+    // FadeOnFunc() (and CurveFunc()) only depend on t scaled to s=0..255, so
+    // the value can only change when s is incremented, or when the final
+    // value is reached at t=period-1.
+    static uint32_t FadeOnNextChange(uint32_t t, uint16_t period) {
+        if (t + 1 >= period) return period;
+        const uint32_t s = ScaleToByte(t, period);
+        const auto next = ((s + 1) * period + 255) >> 8;  // ceil
+        return min(next, static_cast<uint32_t>(period - 1));
+    }
+
+    // FadeOffFunc(t) is FadeOnFunc(period-t), so the scaled time s decrements
+    // as t increases.
+    static uint32_t FadeOffNextChange(uint32_t t, uint16_t period) {
+        if (t >= period) return t + 1;
+        if (t < 2) return min(static_cast<uint32_t>(2), period);
+        const uint32_t s = ScaleToByte(period - t, period);
+        return min(period + 1 - ((s * period + 255) >> 8),
+                   static_cast<uint32_t>(period));
+    }
+
+    static uint32_t BreatheNextChange(uint32_t t, uint16_t period) {
+        if (t + 1 >= period) return period;
+        const uint16_t periodh = period >> 1;
+        const auto next =
+            t < periodh ? FadeOnNextChange(t, periodh)
+                        : periodh + FadeOffNextChange(t - periodh, periodh);
+        return min(next, static_cast<uint32_t>(period - 1));
+    }
+
+    // the fades and curves linearly interpolate a table with n+1 values, i.e.
+    // they are composed of n linear segments stretched to the period.
+    // Returns the end of the segment containing t, i.e. the first t' > t with
+    // t'*n/period reaching the next integer.
+    static uint32_t SegmentEnd(uint32_t t, uint16_t period, uint16_t n) {
+        const uint32_t k = t * n / period + 1;
+        return (k * period + n - 1) / n;
+    }
+
+    // same as SegmentEnd() for the curve evaluated at period-t (FadeOff).
+    static uint32_t ReverseSegmentEnd(uint32_t t, uint16_t period,
+                                      uint16_t n) {
+        const uint32_t u = period - t;
+        const uint32_t k = (u * n + period - 1) / period - 1;
+        return period - k * period / n;
+    }
+
+    static uint32_t BreatheSegmentEnd(uint32_t t, uint16_t period,
+                                      uint16_t n) {
+        const uint16_t periodh = period >> 1;
+        return t < periodh
+                   ? SegmentEnd(t, periodh, n)
+                   : periodh + ReverseSegmentEnd(t - periodh, periodh, n);
+    }
+
+ private:
+    static B LightnessLookup(B val) {
+        return kHighRes ? JLedLightnessTable::Lookup16(val)
+                        : JLedLightnessTable::Lookup(val);
+    }
+
+    static B (*lightness_)(B);
+};
+
+template <typename B>
+constexpr B JLedEffectsT<B>::kFullBrightness;
+template <typename B>
+constexpr B JLedEffectsT<B>::kZeroBrightness;
+template <typename B>
+B (*JLedEffectsT<B>::lightness_)(B) = nullptr;
+
+using JLedEffects = JLedEffectsT<uint8_t>;
+
+// Effect policy of TJLed, which selects the brightness function at runtime.
+// The function is called through a function pointer, which allows to change
+// the effect of a LED at any time. This is the default. The brightness type
+// B of the policy determines the brightness type of the LED.
+template <typename B>
+class JLedDynamicEffectT {
+ public:
+    using Brightness = B;
+    using Func = JLedBrightnessEvalFunctionT<B>;
+
+    template <Func F>
+    void Set() {
+        func_ = F;
+    }
+    void Set(Func func) { func_ = func; }
+    void Stop() { func_ = nullptr; }
+    bool IsActive() const { return func_ != nullptr; }
+    Func func() const { return func_; }
+
+    B Eval(uint32_t t, uint16_t period, uintptr_t param) const {
+        return func_(t, period, param);
+    }
+
+ private:
+    Func func_ = nullptr;
+};
+
+using JLedDynamicEffect = JLedDynamicEffectT<uint8_t>;
+
+// Effect policy of TJLed, with the brightness function F fixed at compile
+// time. F can be inlined into TJLed::Update(), which saves an indirect call
+// per update, e.g.
+//   TJLed<ArduinoAnalogWriter, JLedStaticEffect<&JLedEffects::BreatheFunc>>
+// Only the effect F can be configured on such a LED (i.e. Breathe() in the
+// example), other effects are rejected at compile time.
+template <typename B, JLedBrightnessEvalFunctionT<B> F>
+class JLedStaticEffectT {
+ public:
+    using Brightness = B;
+    using Func = JLedBrightnessEvalFunctionT<B>;
+
+    template <Func G>
+    void Set() {
+        static_assert(G == F, "effect not supported by this JLedStaticEffect");
+        active_ = true;
+    }
+    void Stop() { active_ = false; }
+    bool IsActive() const { return active_; }
+    static constexpr Func func() { return F; }
+
+    B Eval(uint32_t t, uint16_t period, uintptr_t param) const {
+        return F(t, period, param);
+    }
+
+ private:
+    bool active_ = false;
+};
+
+template <JLedBrightnessEvalFunction F>
+using JLedStaticEffect = JLedStaticEffectT<uint8_t, F>;
+
+#endif  // SRC_JLED_EFFECTS_H_
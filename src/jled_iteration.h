@@ -0,0 +1,76 @@
+// Copyright (c) 2017 Jan Delgado <jdelgado[at]gmx.net>
+// https://github.com/jandelgado/jled
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+//
+#ifndef SRC_JLED_ITERATION_H_
+#define SRC_JLED_ITERATION_H_
+
+#include <stdint.h>
+
+// Tracking of the iterations of an effect, shared by TJLed and JLedBank,
+// which store the state (position and iteration counter) themselves. An
+// iteration of an effect consists of the period followed by the delay after
+// phase, i.e. lasts cycle = period + delay_after ticks.
+struct JLedIteration {
+    static constexpr uint16_t kRepeatForever = 65535;
+
+    // advances the position *t in range [0..cycle-1] of the last update by
+    // delta ticks. Instead of calculating the position from a start time
+    // with a modulo operation, which is an expensive division on MCUs
+    // without hardware divider, the position is wrapped by subtraction. The
+    // elapsed time is compared with the time remaining in the iteration, so
+    // that nothing overflows with 32 bit durations. Completed iterations are
+    // added to *iteration, saturating at num_repetitions. Returns true if a
+    // new iteration started. An empty iteration (cycle=0, e.g. FadeOn(0))
+    // completes all repetitions at once.
+    static bool Advance(uint32_t* t, uint32_t cycle, uint32_t delta,
+                        uint16_t* iteration, uint16_t num_repetitions) {
+        if (cycle == 0) {
+            *t = 0;
+            if (num_repetitions != kRepeatForever) *iteration = num_repetitions;
+            return true;
+        }
+        const uint32_t remaining = cycle - *t;
+        if (delta < remaining) {
+            *t += delta;
+            return false;
+        }
+        uint32_t n = 1;  // number of iterations completed
+        *t = delta - remaining;
+        if (*t >= cycle) {
+            // the caller skipped at least one complete iteration.
+            n += *t / cycle;
+            *t %= cycle;
+        }
+        if (num_repetitions != kRepeatForever) {
+            const uint16_t left = num_repetitions - *iteration;
+            *iteration = (n < left) ? *iteration + n : num_repetitions;
+        }
+        return true;
+    }
+
+    // returns true if all repetitions of the effect are completed.
+    static bool IsDone(uint16_t iteration, uint16_t num_repetitions) {
+        return num_repetitions != kRepeatForever &&
+               iteration >= num_repetitions;
+    }
+};
+
+#endif  // SRC_JLED_ITERATION_H_
@@ -0,0 +1,158 @@
+// Copyright (c) 2017 Jan Delgado <jdelgado[at]gmx.net>
+// https://github.com/jandelgado/jled
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+//
+#ifndef SRC_PCA9685_WRITER_H_
+#define SRC_PCA9685_WRITER_H_
+
+#include <Arduino.h>
+#include <Wire.h>
+#include "batched_writer.h"  // NOLINT
+
+// size of the transmit buffer of the Wire library, which limits the number of
+// bytes per I2C transmission (32 on AVR, 128 on the ESP8266 and ESP32).
+#ifndef JLED_WIRE_BUFFER_LENGTH
+#if defined(I2C_BUFFER_LENGTH)
+#define JLED_WIRE_BUFFER_LENGTH I2C_BUFFER_LENGTH
+#elif defined(BUFFER_LENGTH)
+#define JLED_WIRE_BUFFER_LENGTH BUFFER_LENGTH
+#else
+#define JLED_WIRE_BUFFER_LENGTH 32
+#endif
+#endif
+
+// Register access to a PCA9685 16 channel, 12 bit PWM driver on the I2C bus,
+// used as device of JLedBatch (see JLedPca9685T). Changed channels are sent
+// with auto-increment register bursts, up to kMaxBurstChannels channels
+// (4 registers each) per transmission, as limited by the Wire buffer of
+// L bytes. With L>=65, a refresh of all 16 channels is a single transmission.
+template <uint8_t L = JLED_WIRE_BUFFER_LENGTH>
+class JLedPca9685Bus {
+ public:
+    static constexpr uint8_t kNumChannels = 16;
+    static constexpr uint8_t kMaxBurstChannels = (L - 1) / 4;
+    static_assert(kMaxBurstChannels > 0, "Wire buffer too small");
+
+    // registers and bits, see the PCA9685 datasheet
+    static constexpr uint8_t kMode1 = 0x00;
+    static constexpr uint8_t kMode2 = 0x01;
+    static constexpr uint8_t kLed0OnL = 0x06;
+    static constexpr uint8_t kMode1AutoIncrement = 0x20;
+    static constexpr uint8_t kMode1AllCall = 0x01;
+    static constexpr uint8_t kMode2OutDrv = 0x04;
+    static constexpr uint8_t kFullOnOff = 0x10;  // bit 4 of LEDn_ON/OFF_H
+    // time the oscillator needs to start after SLEEP is cleared.
+    static constexpr unsigned int kOscillatorStartupMicros = 500;
+
+    explicit JLedPca9685Bus(uint8_t address) noexcept : address_(address) {}
+
+    // initializes the I2C bus and wakes the chip up with auto-increment
+    // enabled and totem pole outputs. The PWM frequency is the power-on
+    // default of 200 Hz.
+    void Begin() {
+        Wire.begin();
+        WriteRegister(kMode1, kMode1AutoIncrement | kMode1AllCall);
+        delayMicroseconds(kOscillatorStartupMicros);
+        WriteRegister(kMode2, kMode2OutDrv);
+    }
+
+    // sends the channels first..last in bursts of kMaxBurstChannels.
+    void Transfer(const uint16_t* values, uint8_t first, uint8_t last) {
+        while (first <= last) {
+            uint8_t n = last - first + 1;
+            if (n > kMaxBurstChannels) n = kMaxBurstChannels;
+            Wire.beginTransmission(address_);
+            Wire.write(kLed0OnL + 4 * first);
+            for (auto i = first; i < first + n; i++) WriteChannel(values[i]);
+            Wire.endTransmission();
+            first += n;
+        }
+    }
+
+ private:
+    void WriteRegister(uint8_t reg, uint8_t val) {
+        Wire.beginTransmission(address_);
+        Wire.write(reg);
+        Wire.write(val);
+        Wire.endTransmission();
+    }
+
+    // writes LEDn_ON_L, LEDn_ON_H, LEDn_OFF_L, LEDn_OFF_H for the 16 bit
+    // value val, which is scaled to 12 bits. The output is switched on at
+    // count 0 and off at count val, using the full on and full off bits
+    // for the end points.
+    static void WriteChannel(uint16_t val) {
+        const uint16_t val12 = val >> 4;
+        if (val12 == 0) {
+            WriteWord(0);
+            WriteWord(kFullOnOff << 8);
+        } else if (val12 == 0xfff) {
+            WriteWord(kFullOnOff << 8);
+            WriteWord(0);
+        } else {
+            WriteWord(0);
+            WriteWord(val12);
+        }
+    }
+
+    static void WriteWord(uint16_t w) {
+        Wire.write(w & 0xff);
+        Wire.write(w >> 8);
+    }
+
+    uint8_t address_;
+};
+
+// PCA9685 driver with shadow buffer: the Pca9685Writers of the LEDs stage
+// their values, and Commit() sends all changed channels in auto-increment
+// bursts (see JLedBatch):
+//
+//   JLedPca9685 pca;  // default address 0x40
+//   TJLed<Pca9685Writer<>> leds[] = {
+//       TJLed<Pca9685Writer<>>(Pca9685Writer<>(pca, 0)).Breathe(1000),
+//       TJLed<Pca9685Writer<>>(Pca9685Writer<>(pca, 15)).FadeOn(1000)};
+//
+//   void setup() { pca.Begin(); }
+//   void loop() {
+//       UpdateAll(leds, sizeof(leds) / sizeof(leds[0]));
+//       pca.Commit();
+//   }
+template <uint8_t L = JLED_WIRE_BUFFER_LENGTH>
+class JLedPca9685T : public JLedBatch<JLedPca9685Bus<L>> {
+ public:
+    static constexpr uint8_t kDefaultAddress = 0x40;
+
+    explicit JLedPca9685T(uint8_t address = kDefaultAddress) noexcept
+        : JLedBatch<JLedPca9685Bus<L>>(bus_), bus_(address) {}
+
+    void Begin() { bus_.Begin(); }
+
+ private:
+    JLedPca9685Bus<L> bus_;
+};
+
+using JLedPca9685 = JLedPca9685T<>;
+
+// Writer for TJLed, outputting the brightness on a channel (0..15) of a
+// JLedPca9685T<L>. Supports JLed and JLed16.
+template <uint8_t L = JLED_WIRE_BUFFER_LENGTH>
+using Pca9685Writer = BatchedWriter<JLedPca9685Bus<L>>;
+
+#endif  // SRC_PCA9685_WRITER_H_
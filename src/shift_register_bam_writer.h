@@ -0,0 +1,141 @@
+// Copyright (c) 2017 Jan Delgado <jdelgado[at]gmx.net>
+// https://github.com/jandelgado/jled
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+//
+#ifndef SRC_SHIFT_REGISTER_BAM_WRITER_H_
+#define SRC_SHIFT_REGISTER_BAM_WRITER_H_
+
+#include <Arduino.h>
+#include <SPI.h>
+#include "jled_bam.h"  // NOLINT
+
+// BAM engine for LEDs connected to a chain of M 74HC595 shift registers,
+// which are connected to the hardware SPI (MOSI to SER, SCK to SRCLK) and
+// the latch pin (RCLK). The brightness values are stored as bit planes of the
+// register bytes (see JLedBamPlanes), and the timer ISR shifts out one plane
+// per call: 8 interrupts per BAM period, independent of the number of LEDs.
+// The next plane is shifted out in advance, so that the ISR starts with the
+// latch pulse and the timing does not depend on the length of the chain.
+// Output k of register r (r=0 is the register connected to the MCU) is
+// channel 8*r+k.
+//
+//   JLedShiftRegisterBam<2> bam(10);  // 16 LEDs, latch on pin 10
+//   using BamJLed = TJLed<ShiftRegisterBamWriter<2>>;
+//   BamJLed led = BamJLed(ShiftRegisterBamWriter<2>(bam, 3)).Breathe(1000);
+//   JLED_BAM_ISR(bam.Isr());
+//
+//   void setup() { bam.Begin(); }
+//   void loop() { led.Update(); }
+//
+// On AVR, Begin() starts Timer2 (see JLedBamTimer), on other platforms Isr()
+// must be called from a timer, which fires again after the returned number
+// of time units.
+//
+// The ISR must take less than one time unit. It pulses the latch through the
+// cached port register and transfers M bytes, which takes about 2.5us plus
+// 1.2us per register on a 16 MHz AVR with 8 MHz SPI clock. This limits the
+// chain to about M=1 with JLedBamTimer::k64 (4us time unit), M=4 with k128
+// (8us), M=10 with k256 (16us) and M=48 with k1024 (64us). Longer chains
+// stretch the short planes and distort low brightness values.
+template <uint8_t M>
+class JLedShiftRegisterBam {
+    static_assert(M > 0 && M <= 48,
+                  "chain too long for the ISR, even with JLedBamTimer::k1024");
+
+ public:
+    using PortRegister = JLedPortRegister;
+    using PortMask = JLedPortMask;
+    static constexpr uint8_t kNumChannels = 8 * M;
+
+    explicit JLedShiftRegisterBam(uint8_t latch_pin,
+                                  uint32_t spi_clock = 8000000) noexcept
+        : spi_settings_(spi_clock, MSBFIRST, SPI_MODE0),
+          latch_pin_(latch_pin) {}
+
+    // initializes SPI and the latch pin, shifts out the first plane and
+    // starts the timer. Since the ISR uses SPI, the timer interrupt is
+    // registered with SPI.usingInterrupt(), so that transactions of other
+    // devices on the bus (e.g. SD cards or displays) are not interrupted.
+    // Without usingInterrupt() in the SPI library, the bus is exclusive.
+    void Begin(JLedBamTimer::Prescaler prescaler = JLedBamTimer::k256) {
+        ::pinMode(latch_pin_, OUTPUT);
+        ::digitalWrite(latch_pin_, LOW);
+        latch_reg_ = portOutputRegister(digitalPinToPort(latch_pin_));
+        latch_mask_ = digitalPinToBitMask(latch_pin_);
+        SPI.begin();
+#ifdef SPI_HAS_NOTUSINGINTERRUPT
+        SPI.usingInterrupt(JLedBamTimer::kSpiInterrupt);
+#endif
+        shifted_ = planes_.Next();
+        Shift(shifted_);
+        JLedBamTimer::Begin(prescaler);
+    }
+
+    // sets the brightness of channel chan. Can be called while the ISR is
+    // running.
+    void Set(uint8_t chan, uint8_t val) {
+        if (chan >= kNumChannels) return;
+        planes_.Set(chan >> 3, 1 << (chan & 7), val);
+    }
+
+    // latches the plane shifted out during the last call and shifts out the
+    // next one. Returns the number of time units until Isr() must be called
+    // again, i.e. the duration of the latched plane.
+    uint8_t Isr() {
+        *latch_reg_ |= latch_mask_;
+        *latch_reg_ &= ~latch_mask_;
+        const auto b = shifted_;
+        shifted_ = planes_.Next();
+        Shift(shifted_);
+        return 1 << b;
+    }
+
+ private:
+    // shift out plane b, the last register first.
+    void Shift(uint8_t b) {
+        const auto plane = planes_.Plane(b);
+        SPI.beginTransaction(spi_settings_);
+        for (auto r = M; r > 0; r--) SPI.transfer(plane[r - 1]);
+        SPI.endTransaction();
+    }
+
+    JLedBamPlanes<uint8_t, M> planes_;
+    const SPISettings spi_settings_;
+    PortRegister latch_reg_ = nullptr;
+    PortMask latch_mask_ = 0;
+    uint8_t latch_pin_;
+    uint8_t shifted_ = 0;  // plane currently held in the shift registers
+};
+
+// Writer for TJLed, outputting the brightness on channel chan of the given
+// JLedShiftRegisterBam<M> engine.
+template <uint8_t M>
+class ShiftRegisterBamWriter /*: public AnalogWriter */ {
+ public:
+    ShiftRegisterBamWriter(JLedShiftRegisterBam<M>& bam, uint8_t chan) noexcept
+        : bam_(&bam), chan_(chan) {}
+    void analogWrite(uint8_t val) { bam_->Set(chan_, val); }
+
+ private:
+    JLedShiftRegisterBam<M>* bam_;
+    uint8_t chan_;
+};
+
+#endif  // SRC_SHIFT_REGISTER_BAM_WRITER_H_
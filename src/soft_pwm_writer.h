@@ -0,0 +1,205 @@
+// Copyright (c) 2017 Jan Delgado <jdelgado[at]gmx.net>
+// https://github.com/jandelgado/jled
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+//
+#ifndef SRC_SOFT_PWM_WRITER_H_
+#define SRC_SOFT_PWM_WRITER_H_
+
+#include <Arduino.h>
+#include "jled_bam.h"  // NOLINT
+
+#ifndef JLED_SOFT_PWM_MAX_CHANNELS
+#define JLED_SOFT_PWM_MAX_CHANNELS 16
+#endif
+#ifndef JLED_SOFT_PWM_MAX_PORTS
+#define JLED_SOFT_PWM_MAX_PORTS 3
+#endif
+
+// Software PWM on any digital pin, driven by a single timer interrupt, using
+// bit angle modulation (see JLedBamPlanes). The brightness values of all
+// channels are stored as bit planes per port, so the ISR writes each used
+// port register once per phase: the ISR time depends on the number of ports
+// used, not on the number of channels, and there are always 8 interrupts per
+// period.
+//
+// On AVR, Begin() starts Timer2, see JLedBamTimer. The ISR must be defined
+// once in the sketch using JLED_SOFT_PWM_ISR():
+//
+//   #include <jled.h>
+//   #include <soft_pwm_writer.h>
+//
+//   TJLed<SoftPwmWriter> led = TJLed<SoftPwmWriter>(7).Breathe(2000).Forever();
+//   JLED_SOFT_PWM_ISR();
+//
+//   void setup() { JLedSoftPwm::Instance().Begin(); }
+//   void loop() { led.Update(); }
+//
+// On other platforms, call Isr() from a timer, which must fire again after
+// the returned number of time units.
+//
+// Channels are reference counted, since writers are copied (e.g. into
+// TJLed), and are released when the last writer using them is destroyed.
+class JLedSoftPwm {
+ public:
+    using PortRegister = JLedPortRegister;
+    using PortMask = JLedPortMask;
+    static constexpr uint8_t kMaxChannels = JLED_SOFT_PWM_MAX_CHANNELS;
+    static constexpr uint8_t kMaxPorts = JLED_SOFT_PWM_MAX_PORTS;
+    static constexpr int8_t kNoChannel = -1;
+
+    // the engine used by SoftPwmWriter(pin) and JLED_SOFT_PWM_ISR().
+    static JLedSoftPwm& Instance() {
+        static JLedSoftPwm pwm;
+        return pwm;
+    }
+
+    // configures pin as output and attaches it to a free channel, which is
+    // returned. Returns kNoChannel if the pin has no port or if all channels
+    // or ports are in use.
+    int8_t Attach(uint8_t pin) {
+        const auto pin_port = digitalPinToPort(pin);
+        if (pin_port == NOT_A_PORT) return kNoChannel;
+        int8_t chan = 0;
+        while (chan < kMaxChannels && refs_[chan] > 0) chan++;
+        if (chan == kMaxChannels) return kNoChannel;
+        const auto reg = portOutputRegister(pin_port);
+        uint8_t port = 0;
+        while (port < num_ports_ && ports_[port] != reg) port++;
+        if (port == num_ports_) {
+            // reuse a port no longer driven, which the ISR skips.
+            port = 0;
+            while (port < num_ports_ && used_[port] != 0) port++;
+            if (port == num_ports_) {
+                if (num_ports_ >= kMaxPorts) return kNoChannel;
+                num_ports_++;
+            }
+            ports_[port] = reg;
+        }
+        ::pinMode(pin, OUTPUT);
+        const auto mask = digitalPinToBitMask(pin);
+        used_[port] |= mask;
+        channels_[chan] = {port, mask};
+        refs_[chan] = 1;
+        num_channels_++;
+        return chan;
+    }
+
+    // adds a reference to the channel, e.g. when the writer is copied.
+    void Retain(int8_t chan) {
+        if (chan >= 0 && chan < kMaxChannels) refs_[chan]++;
+    }
+
+    // removes a reference to the channel. The last reference detaches the
+    // pin, which is turned off. Returns true if the channel is free now.
+    bool Release(int8_t chan) {
+        if (chan < 0 || chan >= kMaxChannels || refs_[chan] == 0) return false;
+        if (--refs_[chan] > 0) return false;
+        const auto& c = channels_[chan];
+        planes_.Set(c.port, c.mask, 0);
+        used_[c.port] &= ~c.mask;  // no longer written by the ISR
+        noInterrupts();
+        *ports_[c.port] &= ~c.mask;
+        interrupts();
+        num_channels_--;
+        return true;
+    }
+
+    // sets the brightness of channel chan. Can be called while the ISR is
+    // running.
+    void Set(int8_t chan, uint8_t val) {
+        if (chan < 0 || chan >= kMaxChannels || refs_[chan] == 0) return;
+        planes_.Set(channels_[chan].port, channels_[chan].mask, val);
+    }
+
+    // outputs the next BAM phase. Returns the number of time units until
+    // Isr() must be called again.
+    uint8_t Isr() {
+        const auto b = planes_.Next();
+        const auto plane = planes_.Plane(b);
+        for (uint8_t i = 0; i < num_ports_; i++) {
+            const PortMask used = used_[i];
+            if (used == 0) continue;
+            *ports_[i] = (*ports_[i] & ~used) | (plane[i] & used);
+        }
+        return 1 << b;
+    }
+
+    // starts the timer interrupt, see above.
+    void Begin(JLedBamTimer::Prescaler prescaler = JLedBamTimer::k256) {
+        JLedBamTimer::Begin(prescaler);
+    }
+
+    // number of channels in use.
+    uint8_t num_channels() const { return num_channels_; }
+    uint8_t num_ports() const { return num_ports_; }
+    uint8_t refs(int8_t chan) const { return refs_[chan]; }
+
+ private:
+    struct Channel {
+        uint8_t port;  // index into ports_
+        PortMask mask;
+    };
+
+    JLedBamPlanes<PortMask, kMaxPorts> planes_;
+    PortRegister ports_[kMaxPorts] = {};
+    volatile PortMask used_[kMaxPorts] = {};  // pins of the port driven by us
+    Channel channels_[kMaxChannels] = {};
+    uint8_t refs_[kMaxChannels] = {};
+    uint8_t num_ports_ = 0;
+    uint8_t num_channels_ = 0;
+};
+
+// defines the timer ISR driving JLedSoftPwm::Instance().
+#ifdef __AVR__
+#define JLED_SOFT_PWM_ISR() JLED_BAM_ISR(JLedSoftPwm::Instance().Isr())
+#endif
+
+// Writer for TJLed, outputting the brightness on any digital pin using
+// JLedSoftPwm, e.g. TJLed<SoftPwmWriter> led(7). If no channel is available,
+// the writer does nothing. The channel is released when the last copy of the
+// writer is destroyed.
+class SoftPwmWriter /*: public AnalogWriter */ {
+ public:
+    explicit SoftPwmWriter(uint8_t pin) noexcept
+        : SoftPwmWriter(JLedSoftPwm::Instance(), pin) {}
+    SoftPwmWriter(JLedSoftPwm& pwm, uint8_t pin) noexcept
+        : pwm_(&pwm), chan_(pwm.Attach(pin)) {}
+    SoftPwmWriter(const SoftPwmWriter& other) noexcept
+        : pwm_(other.pwm_), chan_(other.chan_) {
+        pwm_->Retain(chan_);
+    }
+    SoftPwmWriter& operator=(const SoftPwmWriter& other) noexcept {
+        other.pwm_->Retain(other.chan_);
+        pwm_->Release(chan_);
+        pwm_ = other.pwm_;
+        chan_ = other.chan_;
+        return *this;
+    }
+    ~SoftPwmWriter() { pwm_->Release(chan_); }
+
+    void analogWrite(uint8_t val) { pwm_->Set(chan_, val); }
+    int8_t chan() const { return chan_; }
+
+ private:
+    JLedSoftPwm* pwm_;
+    int8_t chan_;
+};
+
+#endif  // SRC_SOFT_PWM_WRITER_H_
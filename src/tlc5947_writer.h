@@ -0,0 +1,130 @@
+// Copyright (c) 2017 Jan Delgado <jdelgado[at]gmx.net>
+// https://github.com/jandelgado/jled
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+//
+#ifndef SRC_TLC5947_WRITER_H_
+#define SRC_TLC5947_WRITER_H_
+
+#include <Arduino.h>
+#include <SPI.h>
+#include "batched_writer.h"  // NOLINT
+
+// Frame buffer of a chain of N TLC5947 24 channel, 12 bit LED drivers, used as
+// device of JLedBatch (see JLedTlc5947T). The chips are connected to the
+// hardware SPI (MOSI to DIN of the first chip, SCK to SCLK) and the latch pin
+// (XLAT), BLANK is tied low. The grayscale data of all channels is kept
+// packed in a contiguous frame of 36 bytes per chip, in the order it is
+// shifted out: channel 24*N-1 first, 12 bits MSB first each. Transfer()
+// repacks the changed channels, shifts out the frame and latches it.
+// Channel k of chip i (i=0 is the chip connected to the MCU) is channel
+// 24*i+k.
+template <uint8_t N>
+class JLedTlc5947Bus {
+ public:
+    static constexpr uint8_t kNumChannels = 24 * N;
+    static constexpr uint16_t kFrameSize = 36 * N;
+    static_assert(N > 0 && N <= 10, "1..10 chips supported");
+
+    JLedTlc5947Bus(uint8_t latch_pin, uint32_t spi_clock) noexcept
+        : latch_pin_(latch_pin), spi_clock_(spi_clock) {}
+
+    // initializes SPI and the latch pin and switches all outputs off.
+    void Begin() {
+        ::pinMode(latch_pin_, OUTPUT);
+        ::digitalWrite(latch_pin_, LOW);
+        SPI.begin();
+        Send();
+    }
+
+    void Transfer(const uint16_t* values, uint8_t first, uint8_t last) {
+        for (auto i = first; i <= last; i++) Pack(i, values[i] >> 4);
+        Send();
+    }
+
+    const uint8_t* frame() const { return frame_; }
+
+ private:
+    // shifts out the frame and latches it.
+    void Send() {
+        SPI.beginTransaction(SPISettings(spi_clock_, MSBFIRST, SPI_MODE0));
+        for (uint16_t i = 0; i < kFrameSize; i++) SPI.transfer(frame_[i]);
+        SPI.endTransaction();
+        ::digitalWrite(latch_pin_, HIGH);
+        ::digitalWrite(latch_pin_, LOW);
+    }
+
+    // stores the 12 bit value val of channel chan in the frame. Channel chan
+    // is the j-th 12 bit word shifted out, so two consecutive words share
+    // the middle byte of 3 bytes.
+    void Pack(uint8_t chan, uint16_t val) {
+        const uint8_t j = kNumChannels - 1 - chan;
+        uint8_t* p = &frame_[3 * (j >> 1)];
+        if ((j & 1) == 0) {
+            p[0] = val >> 4;
+            p[1] = (p[1] & 0x0f) | ((val & 0x0f) << 4);
+        } else {
+            p[1] = (p[1] & 0xf0) | (val >> 8);
+            p[2] = val & 0xff;
+        }
+    }
+
+    uint8_t frame_[kFrameSize] = {};
+    uint8_t latch_pin_;
+    uint32_t spi_clock_;
+};
+
+// Chain of N TLC5947 drivers with shadow buffer: the Tlc5947Writers of the
+// LEDs stage their values, and Commit() sends the whole frame once and
+// latches it, if any value changed (see JLedBatch):
+//
+//   JLedTlc5947T<2> tlc(10);  // 48 channels, latch on pin 10
+//   TJLed<Tlc5947Writer<2>> leds[] = {
+//       TJLed<Tlc5947Writer<2>>(Tlc5947Writer<2>(tlc, 0)).Breathe(1000),
+//       TJLed<Tlc5947Writer<2>>(Tlc5947Writer<2>(tlc, 47)).FadeOn(1000)};
+//
+//   void setup() { tlc.Begin(); }
+//   void loop() {
+//       UpdateAll(leds, sizeof(leds) / sizeof(leds[0]));
+//       tlc.Commit();
+//   }
+template <uint8_t N>
+class JLedTlc5947T : public JLedBatch<JLedTlc5947Bus<N>> {
+ public:
+    explicit JLedTlc5947T(uint8_t latch_pin,
+                          uint32_t spi_clock = 8000000) noexcept
+        : JLedBatch<JLedTlc5947Bus<N>>(bus_), bus_(latch_pin, spi_clock) {}
+
+    // initializes SPI and the latch pin and switches all outputs off.
+    void Begin() { bus_.Begin(); }
+
+    const JLedTlc5947Bus<N>& bus() const { return bus_; }
+
+ private:
+    JLedTlc5947Bus<N> bus_;
+};
+
+using JLedTlc5947 = JLedTlc5947T<1>;
+
+// Writer for TJLed, outputting the brightness on a channel of a chain of N
+// TLC5947 (see JLedTlc5947T). Supports JLed and JLed16.
+template <uint8_t N>
+using Tlc5947Writer = BatchedWriter<JLedTlc5947Bus<N>>;
+
+#endif  // SRC_TLC5947_WRITER_H_
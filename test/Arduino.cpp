@@ -1,19 +1,29 @@
 // Minimal Arduino mock for testing JLed
 // Copyright 2017 Jan Delgado jdelgado@gmx.net
 //
+#include <chrono>     // NOLINT
 #include "Arduino.h"  // NOLINT
+#include "driver/ledc.h"  // NOLINT
 #include <time.h>     // NOLINT
 #include <cstring>    // NOLINT
 
 
 struct ArduinoState {
     time_t millis;  // current time
+    uint32_t micros;  // current time in us, independent of millis
 
     int pin_state[ARDUINO_PINS];
+    int analog_write_count[ARDUINO_PINS];
+    int digital_write_count[ARDUINO_PINS];
+    int rising_edge_count[ARDUINO_PINS];
     uint8_t pin_modes[ARDUINO_PINS];
+    uint8_t ports[ARDUINO_PINS / 8 + 1];
+    uint32_t pin_high_ticks[ARDUINO_PINS];
 
     // records ESP32 specific calls to ledc* functions.
     uint32_t ledc_state[LEDC_CHANNELS];
+    int ledc_write_count[LEDC_CHANNELS];
+    struct LedcFadeState ledc_fade[LEDC_CHANNELS];
     struct LedcSetupState ledc_setup[LEDC_CHANNELS];
     uint8_t ledc_pin_attachments[ARDUINO_PINS];
 } ArduinoState_;
@@ -31,14 +41,87 @@ uint8_t arduinoMockGetPinMode(uint8_t pin) {
 
 void analogWrite(uint8_t pin, int value) {
     ArduinoState_.pin_state[pin] = value;
+    ArduinoState_.analog_write_count[pin]++;
 }
 
 int arduinoMockGetPinState(uint8_t pin) { return ArduinoState_.pin_state[pin]; }
 
+int arduinoMockGetAnalogWriteCount(uint8_t pin) {
+    return ArduinoState_.analog_write_count[pin];
+}
+
+void digitalWrite(uint8_t pin, uint8_t val) {
+    if (val == HIGH && ArduinoState_.pin_state[pin] == LOW) {
+        ArduinoState_.rising_edge_count[pin]++;
+    }
+    ArduinoState_.pin_state[pin] = val;
+    ArduinoState_.digital_write_count[pin]++;
+}
+
+int arduinoMockGetDigitalWriteCount(uint8_t pin) {
+    return ArduinoState_.digital_write_count[pin];
+}
+
+int arduinoMockGetRisingEdgeCount(uint8_t pin) {
+    return ArduinoState_.rising_edge_count[pin];
+}
+
 uint32_t millis(void) { return ArduinoState_.millis; }
 
 void arduinoMockSetMillis(uint32_t value) { ArduinoState_.millis = value; }
 
+uint32_t micros(void) { return ArduinoState_.micros; }
+
+void arduinoMockSetMicros(uint32_t value) { ArduinoState_.micros = value; }
+
+void delayMicroseconds(unsigned int us) { ArduinoState_.micros += us; }
+
+uint8_t digitalPinToPort(uint8_t pin) {
+    return pin < ARDUINO_PINS ? pin / 8 + 1 : NOT_A_PORT;
+}
+
+uint8_t digitalPinToBitMask(uint8_t pin) { return 1 << (pin % 8); }
+
+volatile uint8_t* portOutputRegister(uint8_t port) {
+    return &ArduinoState_.ports[port];
+}
+
+bool arduinoMockGetPortPinState(uint8_t pin) {
+    return (*portOutputRegister(digitalPinToPort(pin)) &
+            digitalPinToBitMask(pin)) != 0;
+}
+
+ArduinoMockTimerStats arduinoMockRunTimer(uint8_t (*isr)(), uint32_t ticks) {
+    using Clock = std::chrono::steady_clock;
+    ArduinoMockTimerStats stats = {0, 0.};
+    Clock::duration isr_time(0);
+    uint32_t tick = 0;
+    while (tick < ticks) {
+        const auto start = Clock::now();
+        const uint32_t duration = isr();
+        isr_time += Clock::now() - start;
+        stats.isr_calls++;
+
+        const auto n = min(duration, ticks - tick);
+        for (auto pin = 0; pin < ARDUINO_PINS; pin++) {
+            if (arduinoMockGetPortPinState(pin)) {
+                ArduinoState_.pin_high_ticks[pin] += n;
+            }
+        }
+        tick += n;
+    }
+    if (stats.isr_calls > 0) {
+        stats.ns_per_isr_call =
+            std::chrono::duration<double, std::nano>(isr_time).count() /
+            stats.isr_calls;
+    }
+    return stats;
+}
+
+uint32_t arduinoMockGetPinHighTicks(uint8_t pin) {
+    return ArduinoState_.pin_high_ticks[pin];
+}
+
 // EPS32 specific
 double ledcSetup(uint8_t chan, double freq, uint8_t bit_num) {
     ArduinoState_.ledc_setup[chan] = {freq, bit_num};
@@ -54,6 +137,10 @@ void ledcAttachPin(uint8_t pin, uint8_t chan) {
     ArduinoState_.ledc_pin_attachments[pin] = chan;
 }
 
+void ledcDetachPin(uint8_t pin) {
+    ArduinoState_.ledc_pin_attachments[pin] = LEDC_MOCK_DETACHED;
+}
+
 uint8_t arduinoMockGetLedcAttachPin(uint8_t pin) {
     return ArduinoState_.ledc_pin_attachments[pin];
 }
@@ -61,9 +148,38 @@ uint8_t arduinoMockGetLedcAttachPin(uint8_t pin) {
 // EPS32 specific
 void ledcWrite(uint8_t chan, uint32_t duty) {
     ArduinoState_.ledc_state[chan] = duty;
+    ArduinoState_.ledc_write_count[chan]++;
 }
 
 uint32_t arduinoMockGetLedcState(uint8_t chan) {
     return ArduinoState_.ledc_state[chan];
 }
 
+int arduinoMockGetLedcWriteCount(uint8_t chan) {
+    return ArduinoState_.ledc_write_count[chan];
+}
+
+// EPS32 specific, ESP-IDF ledc driver
+esp_err_t ledc_fade_func_install(int) { return ESP_OK; }
+
+esp_err_t ledc_set_fade_with_time(ledc_mode_t speed_mode,
+                                  ledc_channel_t channel, uint32_t target_duty,
+                                  int max_fade_time_ms) {
+    auto& fade = ArduinoState_.ledc_fade[speed_mode * 8 + channel];
+    fade.target_duty = target_duty;
+    fade.time_ms = max_fade_time_ms;
+    return ESP_OK;
+}
+
+esp_err_t ledc_fade_start(ledc_mode_t speed_mode, ledc_channel_t channel,
+                          ledc_fade_mode_t) {
+    const auto chan = speed_mode * 8 + channel;
+    ArduinoState_.ledc_fade[chan].count++;
+    ArduinoState_.ledc_state[chan] = ArduinoState_.ledc_fade[chan].target_duty;
+    return ESP_OK;
+}
+
+struct LedcFadeState arduinoMockGetLedcFade(uint8_t chan) {
+    return ArduinoState_.ledc_fade[chan];
+}
+
@@ -16,15 +16,59 @@ uint8_t arduinoMockGetPinMode(uint8_t pin);
 
 void analogWrite(uint8_t pint, int value);
 int arduinoMockGetPinState(uint8_t pin);
+// returns number of analogWrite() calls to the given pin
+int arduinoMockGetAnalogWriteCount(uint8_t pin);
+
+// digitalWrite() sets the pin state as returned by arduinoMockGetPinState()
+void digitalWrite(uint8_t pin, uint8_t val);
+// returns number of digitalWrite() calls to the given pin
+int arduinoMockGetDigitalWriteCount(uint8_t pin);
+// returns number of LOW to HIGH transitions of the given pin caused by
+// digitalWrite(), e.g. latch pulses.
+int arduinoMockGetRisingEdgeCount(uint8_t pin);
 
 uint32_t millis(void);
 void arduinoMockSetMillis(uint32_t value);
+uint32_t micros(void);
+void arduinoMockSetMicros(uint32_t value);
+// busy waits by advancing the micros() time.
+void delayMicroseconds(unsigned int us);
+
+// port registers as used for direct port manipulation on AVR. The mock maps
+// pin p to bit p % 8 of port p / 8 + 1 (port 0 is NOT_A_PORT, returned for
+// pins >= ARDUINO_PINS).
+#define NOT_A_PORT 0
+uint8_t digitalPinToPort(uint8_t pin);
+uint8_t digitalPinToBitMask(uint8_t pin);
+volatile uint8_t* portOutputRegister(uint8_t port);
+// returns state of pin as set using its port register
+bool arduinoMockGetPortPinState(uint8_t pin);
+
+// there are no interrupts on the host.
+inline void noInterrupts() {}
+inline void interrupts() {}
+
+// Simulation of a timer interrupt for the given number of timer ticks. isr is
+// called whenever the timer fires (starting at tick 0) and returns the
+// number of ticks until it fires again. The number of ticks each pin is high
+// (according to its port register) is recorded, see
+// arduinoMockGetPinHighTicks(). The host time spent in isr is measured.
+struct ArduinoMockTimerStats {
+    uint32_t isr_calls;
+    double ns_per_isr_call;  // average host time spent per isr call
+};
+ArduinoMockTimerStats arduinoMockRunTimer(uint8_t (*isr)(), uint32_t ticks);
+uint32_t arduinoMockGetPinHighTicks(uint8_t pin);
 
 #define min(a, b) ((a) < (b) ? (a) : (b))
 #define max(a, b) ((a) > (b) ? (a) : (b))
 
 #define PI 3.1415926535897932384626433832795
 #define OUTPUT 0x1
+#define LOW 0x0
+#define HIGH 0x1
+#define LSBFIRST 0
+#define MSBFIRST 1
 
 // ESP32 sepcific functions, see
 // packages/framework-arduinoespressif32/cores/esp32/esp32-hal-ledc.h
@@ -39,10 +83,17 @@ struct LedcSetupState {
 struct LedcSetupState arduinoMockGetLedcSetup(uint8_t chan);
 
 void ledcAttachPin(uint8_t pin, uint8_t chan);
+void ledcDetachPin(uint8_t pin);
+// channel the pin is attached to, LEDC_MOCK_DETACHED after ledcDetachPin()
+constexpr uint8_t LEDC_MOCK_DETACHED = 0xff;
 uint8_t arduinoMockGetLedcAttachPin(uint8_t pin);
 
 void ledcWrite(uint8_t chan, uint32_t duty);
+// duty of channel chan, as set by ledcWrite() or by a completed hardware fade
+// (fades complete immediately in the mock, see driver/ledc.h)
 uint32_t arduinoMockGetLedcState(uint8_t chan);
+// number of ledcWrite() calls for channel chan
+int arduinoMockGetLedcWriteCount(uint8_t chan);
 
 
 #endif  // TEST_ARDUINO_H_
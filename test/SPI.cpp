@@ -0,0 +1,58 @@
+// SPI mock for unit testing JLed writers using SPI.
+// Copyright 2017 Jan Delgado jdelgado@gmx.net
+#include "SPI.h"  // NOLINT
+#include <cstring>  // NOLINT
+
+SPIClass SPI;
+
+struct SpiState {
+    bool initialized;
+    int using_interrupt;
+    bool in_transaction;
+    int transaction_count;
+    SPISettings settings;
+    int size;
+    uint8_t bytes[SPI_MOCK_MAX_BYTES];
+} SpiState_;
+
+void spiMockInit() {
+    SpiState_ = SpiState();
+    SpiState_.using_interrupt = -1;
+}
+
+void SPIClass::begin() { SpiState_.initialized = true; }
+
+void SPIClass::usingInterrupt(uint8_t interruptNumber) {
+    SpiState_.using_interrupt = interruptNumber;
+}
+
+void SPIClass::beginTransaction(SPISettings settings) {
+    SpiState_.in_transaction = true;
+    SpiState_.transaction_count++;
+    SpiState_.settings = settings;
+    SpiState_.size = 0;
+}
+
+uint8_t SPIClass::transfer(uint8_t data) {
+    if (SpiState_.size < SPI_MOCK_MAX_BYTES) {
+        SpiState_.bytes[SpiState_.size] = data;
+    }
+    SpiState_.size++;
+    return 0;
+}
+
+void SPIClass::endTransaction() { SpiState_.in_transaction = false; }
+
+bool spiMockIsInitialized() { return SpiState_.initialized; }
+
+int spiMockGetUsingInterrupt() { return SpiState_.using_interrupt; }
+
+int spiMockGetTransactionCount() { return SpiState_.transaction_count; }
+
+SPISettings spiMockGetSettings() { return SpiState_.settings; }
+
+int spiMockGetTransactionSize() { return SpiState_.size; }
+
+uint8_t spiMockGetTransactionByte(int i) { return SpiState_.bytes[i]; }
+
+bool spiMockInTransaction() { return SpiState_.in_transaction; }
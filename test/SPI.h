@@ -0,0 +1,49 @@
+// SPI mock for unit testing JLed writers using SPI.
+// Copyright 2017 Jan Delgado jdelgado@gmx.net
+#ifndef TEST_SPI_H_
+#define TEST_SPI_H_
+
+#include <Arduino.h>
+
+constexpr auto SPI_MOCK_MAX_BYTES = 1024;
+
+#define SPI_MODE0 0x00
+// like the AVR SPI library, which provides usingInterrupt()
+#define SPI_HAS_NOTUSINGINTERRUPT 1
+
+struct SPISettings {
+    SPISettings(uint32_t clock, uint8_t bit_order, uint8_t data_mode)
+        : clock(clock), bit_order(bit_order), data_mode(data_mode) {}
+    SPISettings() : SPISettings(4000000, MSBFIRST, SPI_MODE0) {}
+    uint32_t clock;
+    uint8_t bit_order;
+    uint8_t data_mode;
+};
+
+class SPIClass {
+ public:
+    void begin();
+    void usingInterrupt(uint8_t interruptNumber);
+    void beginTransaction(SPISettings settings);
+    uint8_t transfer(uint8_t data);
+    void endTransaction();
+};
+
+extern SPIClass SPI;
+
+void spiMockInit();
+bool spiMockIsInitialized();  // true after SPI.begin()
+// interrupt number last passed to usingInterrupt(), or -1
+int spiMockGetUsingInterrupt();
+// number of transactions started with beginTransaction()
+int spiMockGetTransactionCount();
+// settings of the last transaction
+SPISettings spiMockGetSettings();
+// number of bytes transferred in the current (or last) transaction
+int spiMockGetTransactionSize();
+// byte i transferred in the current (or last) transaction
+uint8_t spiMockGetTransactionByte(int i);
+// true if a transaction is in progress
+bool spiMockInTransaction();
+
+#endif  // TEST_SPI_H_
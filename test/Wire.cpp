@@ -0,0 +1,65 @@
+// Wire (I2C) mock for unit testing JLed writers using I2C.
+// Copyright 2017 Jan Delgado jdelgado@gmx.net
+#include "Wire.h"  // NOLINT
+
+TwoWire Wire;
+
+struct Transmission {
+    uint8_t address;
+    int size;
+    uint8_t bytes[BUFFER_LENGTH];
+};
+
+struct WireState {
+    bool initialized;
+    bool in_transmission;
+    int count;  // number of completed transmissions
+    Transmission transmissions[WIRE_MOCK_MAX_TRANSMISSIONS + 1];
+} WireState_;
+
+// the transmission currently in progress
+static Transmission& Current() {
+    const auto t = min(WireState_.count, WIRE_MOCK_MAX_TRANSMISSIONS);
+    return WireState_.transmissions[t];
+}
+
+void wireMockInit() { WireState_ = WireState(); }
+
+void TwoWire::begin() { WireState_.initialized = true; }
+
+void TwoWire::beginTransmission(uint8_t address) {
+    WireState_.in_transmission = true;
+    Current().address = address;
+    Current().size = 0;
+}
+
+size_t TwoWire::write(uint8_t data) {
+    auto& t = Current();
+    if (!WireState_.in_transmission || t.size >= BUFFER_LENGTH) return 0;
+    t.bytes[t.size++] = data;
+    return 1;
+}
+
+uint8_t TwoWire::endTransmission() {
+    WireState_.in_transmission = false;
+    WireState_.count++;
+    return 0;
+}
+
+bool wireMockIsInitialized() { return WireState_.initialized; }
+
+int wireMockGetTransmissionCount() { return WireState_.count; }
+
+uint8_t wireMockGetAddress(int t) {
+    return WireState_.transmissions[t].address;
+}
+
+int wireMockGetTransmissionSize(int t) {
+    return WireState_.transmissions[t].size;
+}
+
+uint8_t wireMockGetTransmissionByte(int t, int i) {
+    return WireState_.transmissions[t].bytes[i];
+}
+
+bool wireMockInTransmission() { return WireState_.in_transmission; }
@@ -0,0 +1,37 @@
+// Wire (I2C) mock for unit testing JLed writers using I2C.
+// Copyright 2017 Jan Delgado jdelgado@gmx.net
+#ifndef TEST_WIRE_H_
+#define TEST_WIRE_H_
+
+#include <Arduino.h>
+
+// size of the transmit buffer of the Wire library, as on the ESP8266. Bytes
+// exceeding the buffer are dropped by write().
+#define BUFFER_LENGTH 128
+
+constexpr auto WIRE_MOCK_MAX_TRANSMISSIONS = 64;
+
+class TwoWire {
+ public:
+    void begin();
+    void beginTransmission(uint8_t address);
+    size_t write(uint8_t data);
+    uint8_t endTransmission();
+};
+
+extern TwoWire Wire;
+
+void wireMockInit();
+bool wireMockIsInitialized();  // true after Wire.begin()
+// number of transmissions completed with endTransmission()
+int wireMockGetTransmissionCount();
+// address of transmission t
+uint8_t wireMockGetAddress(int t);
+// number of bytes sent in transmission t
+int wireMockGetTransmissionSize(int t);
+// byte i sent in transmission t
+uint8_t wireMockGetTransmissionByte(int t, int i);
+// true if a transmission is in progress
+bool wireMockInTransmission();
+
+#endif  // TEST_WIRE_H_
@@ -0,0 +1,129 @@
+// JLed host benchmark: compares the runtime (function pointer) dispatch of
+// brightness functions with the compile time dispatch of JLedStaticEffect,
+// and an array of JLed objects with a JLedBank.
+// Build and run with `make bench`. Copyright 2017 Jan Delgado jdelgado@gmx.net
+#include <stdio.h>
+#include <chrono>  // NOLINT
+#include <vector>
+
+#include <jled.h>  // NOLINT
+
+// writer which does not touch the mock, so we only measure JLed itself.
+class NullWriter {
+ public:
+    explicit NullWriter(uint8_t) noexcept {}
+    void analogWrite(uint8_t val) { sink_ = val; }
+
+ private:
+    static volatile uint8_t sink_;
+};
+volatile uint8_t NullWriter::sink_;
+
+constexpr auto kNumLeds = 64;
+constexpr uint32_t kNumTicks = 100000;
+
+using DynamicLed = TJLed<NullWriter>;
+template <JLedBrightnessEvalFunction F>
+using StaticLed = TJLed<NullWriter, JLedStaticEffect<F>>;
+
+// calls update(now) for kNumTicks ticks and prints time needed per LED update
+template <typename F>
+double Measure(const char* name, F update) {
+    const auto start = std::chrono::steady_clock::now();
+    for (uint32_t now = 0; now < kNumTicks; now++) update(now);
+    const auto end = std::chrono::steady_clock::now();
+    const auto ns =
+        std::chrono::duration_cast<std::chrono::nanoseconds>(end - start)
+            .count() /
+        static_cast<double>(kNumLeds * kNumTicks);
+    printf("%-28s %6.2f ns/update\n", name, ns);
+    return ns;
+}
+
+// configure LEDs in a non-inlined function, so the compiler can not
+// propagate the function pointers of the dynamic LEDs into Update().
+template <typename L>
+__attribute__((noinline)) void Configure(std::vector<L>* leds,
+                                         L (*config)(uint8_t)) {
+    for (auto i = 0; i < kNumLeds; i++) leds->push_back(config(i));
+}
+
+template <typename L>
+double Run(const char* name, L (*config)(uint8_t)) {
+    std::vector<L> leds;
+    Configure(&leds, config);
+
+    return Measure(name, [&leds](uint32_t now) {
+        UpdateAll(leds.data(), leds.size(), now);
+    });
+}
+
+// configure all LEDs of the bank like the array of LEDs in Run()
+template <size_t N>
+__attribute__((noinline)) void ConfigureBank(JLedBank<N, NullWriter>* bank) {
+    for (size_t i = 0; i < N; i++) {
+        switch (i % 3) {
+            case 0:
+                (*bank)[i].Breathe(2000 + i).Forever();
+                break;
+            case 1:
+                (*bank)[i].Blink(500, 500 + i).Forever();
+                break;
+            default:
+                (*bank)[i].FadeOn(1000 + i).Forever();
+        }
+    }
+}
+
+// JLedBank takes one constructor argument per LED, so we generate the
+// sequence 0..kNumLeds-1 to construct the bank.
+template <size_t... I>
+struct Seq {};
+template <size_t N, size_t... I>
+struct MakeSeq : MakeSeq<N - 1, N - 1, I...> {};
+template <size_t... I>
+struct MakeSeq<0, I...> : Seq<I...> {};
+
+template <size_t... I>
+JLedBank<sizeof...(I), NullWriter>* NewBank(Seq<I...>) {
+    return new JLedBank<sizeof...(I), NullWriter>(static_cast<uint8_t>(I)...);
+}
+
+double RunBank(const char* name) {
+    auto bank = NewBank(MakeSeq<kNumLeds>());
+    ConfigureBank(bank);
+    const auto ns = Measure(name, [bank](uint32_t now) { bank->Update(now); });
+    delete bank;
+    return ns;
+}
+
+int main() {
+    Run<DynamicLed>("Breathe (dynamic)", [](uint8_t i) {
+        return DynamicLed(i).Breathe(2000 + i).Forever();
+    });
+    Run<StaticLed<&JLedEffects::BreatheFunc>>("Breathe (static)", [](uint8_t i) {
+        return StaticLed<&JLedEffects::BreatheFunc>(i)
+            .Breathe(2000 + i)
+            .Forever();
+    });
+    Run<DynamicLed>("Blink (dynamic)", [](uint8_t i) {
+        return DynamicLed(i).Blink(500, 500 + i).Forever();
+    });
+    Run<StaticLed<&JLedEffects::BlinkFunc>>("Blink (static)", [](uint8_t i) {
+        return StaticLed<&JLedEffects::BlinkFunc>(i)
+            .Blink(500, 500 + i)
+            .Forever();
+    });
+    Run<DynamicLed>("mixed effects (JLed[])", [](uint8_t i) {
+        switch (i % 3) {
+            case 0:
+                return DynamicLed(i).Breathe(2000 + i).Forever();
+            case 1:
+                return DynamicLed(i).Blink(500, 500 + i).Forever();
+            default:
+                return DynamicLed(i).FadeOn(1000 + i).Forever();
+        }
+    });
+    RunBank("mixed effects (JLedBank)");
+    return 0;
+}
@@ -0,0 +1,52 @@
+// Mock of the ESP-IDF ledc driver (hardware fades) for testing JLed
+// Copyright 2017 Jan Delgado jdelgado@gmx.net
+#ifndef TEST_DRIVER_LEDC_H_
+#define TEST_DRIVER_LEDC_H_
+
+#include <stdint.h>
+
+// subset of esp-idf/components/driver/include/driver/ledc.h
+typedef int esp_err_t;
+#define ESP_OK 0
+
+// defined by soc/soc_caps.h of the original ESP32 only. Build with
+// -DLEDC_MOCK_NO_HS_MODE to mock chips without high speed channels.
+#ifndef LEDC_MOCK_NO_HS_MODE
+#define SOC_LEDC_SUPPORT_HS_MODE (1)
+#endif
+
+typedef enum {
+#ifdef SOC_LEDC_SUPPORT_HS_MODE
+    LEDC_HIGH_SPEED_MODE = 0,
+#endif
+    LEDC_LOW_SPEED_MODE,
+} ledc_mode_t;
+
+typedef enum {
+    LEDC_CHANNEL_0 = 0,
+    LEDC_CHANNEL_7 = 7,
+} ledc_channel_t;
+
+typedef enum {
+    LEDC_FADE_NO_WAIT = 0,
+    LEDC_FADE_WAIT_DONE,
+} ledc_fade_mode_t;
+
+esp_err_t ledc_fade_func_install(int intr_alloc_flags);
+esp_err_t ledc_set_fade_with_time(ledc_mode_t speed_mode,
+                                  ledc_channel_t channel, uint32_t target_duty,
+                                  int max_fade_time_ms);
+esp_err_t ledc_fade_start(ledc_mode_t speed_mode, ledc_channel_t channel,
+                          ledc_fade_mode_t fade_mode);
+
+// records the hardware fades of a ledc channel. Channels are numbered as in
+// the Arduino ledc functions, i.e. 8..15 are the low speed channels 0..7.
+struct LedcFadeState {
+    int count;             // number of fades started with ledc_fade_start()
+    uint32_t target_duty;  // of the last fade
+    int time_ms;           // of the last fade
+};
+
+struct LedcFadeState arduinoMockGetLedcFade(uint8_t chan);
+
+#endif  // TEST_DRIVER_LEDC_H_
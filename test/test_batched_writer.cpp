@@ -0,0 +1,122 @@
+// JLed batched writer unit tests (run on host).
+// Copyright 2017 Jan Delgado jdelgado@gmx.net
+#include <vector>
+#include "catch.hpp"
+#include <jled.h>             // NOLINT
+#include <jled_bank.h>        // NOLINT
+#include <batched_writer.h>  // NOLINT
+
+// device on a mock bus, recording every transaction
+class MockBusDevice {
+ public:
+    static constexpr uint8_t kNumChannels = 8;
+
+    struct Transaction {
+        uint8_t first;
+        uint8_t last;
+        std::vector<uint16_t> values;
+    };
+
+    void Transfer(const uint16_t* values, uint8_t first, uint8_t last) {
+        transactions.push_back(
+            Transaction{first, last,
+                        std::vector<uint16_t>(values, values + kNumChannels)});
+    }
+
+    std::vector<Transaction> transactions;
+};
+
+using BatchedJLed = TJLed<BatchedWriter<MockBusDevice>>;
+using BatchedJLed16 =
+    TJLed<BatchedWriter<MockBusDevice>, JLedDynamicEffectT<uint16_t>>;
+
+TEST_CASE("batch sends nothing without changes", "[batched_writer]") {
+    MockBusDevice device;
+    JLedBatch<MockBusDevice> batch(device);
+
+    REQUIRE_FALSE(batch.IsDirty());
+    REQUIRE_FALSE(batch.Commit());
+    batch.Stage(2, 0);  // unchanged value
+    REQUIRE_FALSE(batch.Commit());
+    REQUIRE(device.transactions.empty());
+}
+
+TEST_CASE("batch commits changed channel range in one transaction",
+          "[batched_writer]") {
+    MockBusDevice device;
+    JLedBatch<MockBusDevice> batch(device);
+
+    batch.Stage(5, 1000);
+    batch.Stage(2, 2000);
+    batch.Stage(3, 3000);
+    batch.Stage(MockBusDevice::kNumChannels, 4000);  // ignored
+    REQUIRE(batch.IsDirty());
+    REQUIRE(device.transactions.empty());
+
+    REQUIRE(batch.Commit());
+    REQUIRE(device.transactions.size() == 1);
+    REQUIRE(device.transactions[0].first == 2);
+    REQUIRE(device.transactions[0].last == 5);
+    REQUIRE(device.transactions[0].values ==
+            std::vector<uint16_t>({0, 0, 2000, 3000, 0, 1000, 0, 0}));
+    REQUIRE_FALSE(batch.IsDirty());
+
+    batch.Stage(7, 1);
+    REQUIRE(batch.Commit());
+    REQUIRE(device.transactions.size() == 2);
+    REQUIRE(device.transactions[1].first == 7);
+    REQUIRE(device.transactions[1].last == 7);
+}
+
+TEST_CASE("group update of LEDs results in one transaction per tick",
+          "[batched_writer]") {
+    MockBusDevice device;
+    JLedBatch<MockBusDevice> batch(device);
+    BatchedJLed leds[] = {
+        BatchedJLed(BatchedWriter<MockBusDevice>(batch, 0)).On(),
+        BatchedJLed(BatchedWriter<MockBusDevice>(batch, 1)).FadeOn(100),
+        BatchedJLed(BatchedWriter<MockBusDevice>(batch, 6)).FadeOff(100)};
+
+    // at most one transaction per tick, none if no value changed
+    size_t commits = 0;
+    for (uint32_t t = 0; t < 50; t++) {
+        UpdateAll(leds, 3, t);
+        commits += batch.Commit();
+        REQUIRE(device.transactions.size() == commits);
+    }
+    REQUIRE(commits > 1);
+    REQUIRE(device.transactions[0].first == 0);
+    REQUIRE(device.transactions[0].last == 6);
+    REQUIRE(device.transactions[0].values[0] == 0xffff);
+    REQUIRE(device.transactions.back().values[1] ==
+            257 * JLedEffects::FadeOnFunc(49, 100, 0));
+    REQUIRE(device.transactions.back().values[6] ==
+            257 * JLedEffects::FadeOffFunc(49, 100, 0));
+}
+
+TEST_CASE("batched writer stages 16 bit values", "[batched_writer]") {
+    MockBusDevice device;
+    JLedBatch<MockBusDevice> batch(device);
+    auto led = BatchedJLed16(BatchedWriter<MockBusDevice>(batch, 4))
+                   .FadeOn(1000);
+
+    led.Update(0);
+    led.Update(500);
+    REQUIRE(batch.Value(4) == JLedEffectsT<uint16_t>::FadeOnFunc(500, 1000, 0));
+}
+
+TEST_CASE("bank writes to batch", "[batched_writer]") {
+    MockBusDevice device;
+    JLedBatch<MockBusDevice> batch(device);
+    JLedBank<2, BatchedWriter<MockBusDevice>> bank(
+        BatchedWriter<MockBusDevice>(batch, 1),
+        BatchedWriter<MockBusDevice>(batch, 3));
+    bank[0].On();
+    bank[1].On();
+
+    bank.Update(0);
+    REQUIRE(batch.Commit());
+    REQUIRE(device.transactions.size() == 1);
+    REQUIRE(device.transactions[0].first == 1);
+    REQUIRE(device.transactions[0].last == 3);
+}
@@ -1,8 +1,11 @@
 // JLed Unit tests  (run on host).
 // Copyright 2017 Jan Delgado jdelgado@gmx.net
 #define CATCH_CONFIG_MAIN
+#include <vector>
 #include "catch.hpp"
+#include <jled.h>  // NOLINT
 #include <esp32_analog_writer.h>  // NOLINT
+#include <driver/ledc.h>  // NOLINT
 
 TEST_CASE("ledc ctor correctly initializes hardware", "[esp32_analog_writer]") {
     arduinoMockInit();
@@ -19,17 +22,113 @@ TEST_CASE("ledc ctor correctly initializes hardware", "[esp32_analog_writer]") {
     REQUIRE(arduinoMockGetLedcAttachPin(kPin) == kChan);
 }
 
-TEST_CASE("ledc correctly autoselects channels", "[esp32_analog_writer]") {
+TEST_CASE("ledc allocates free channels until exhausted",
+          "[esp32_analog_writer]") {
+    arduinoMockInit();
+    constexpr auto kPin = 10;
+    // all writers are released at the end of each test, so the static
+    // allocator starts with all channels free.
+    REQUIRE(Esp32AnalogWriter::allocator().num_free() == 16);
+
+    std::vector<Esp32AnalogWriter> writers;
+    writers.reserve(17);
+    for (auto i = 0; i < 16; i++) {
+        writers.emplace_back(kPin + i);
+        REQUIRE(writers.back().chan() == i);
+        REQUIRE(writers.back().valid());
+    }
+    REQUIRE(Esp32AnalogWriter::allocator().num_free() == 0);
+
+    // exhausted: the writer reports it and does not output anything
+    writers.emplace_back(kPin);
+    REQUIRE_FALSE(writers.back().valid());
+    REQUIRE(writers.back().chan() == JLedLedcAllocator::kNoChan);
+    writers.back().analogWrite(255);
+    writers.pop_back();
+
+    // a released channel is reused
+    writers.erase(writers.begin() + 5);
+    REQUIRE(arduinoMockGetLedcAttachPin(kPin + 5) == LEDC_MOCK_DETACHED);
+    REQUIRE(Esp32AnalogWriter(kPin).chan() == 5);
+}
+
+TEST_CASE("ledc channels share timers with the same settings",
+          "[esp32_analog_writer]") {
+    arduinoMockInit();
+    constexpr auto kPin = 10;
+    REQUIRE(JLedLedcAllocator::Timer(0) == JLedLedcAllocator::Timer(1));
+    REQUIRE(JLedLedcAllocator::Timer(7) == 3);
+    REQUIRE(JLedLedcAllocator::Timer(8) == 4);
+
+    auto a = Esp32AnalogWriter(kPin, Esp32AnalogWriter::kAutoSelectChan, 5000);
+    auto b = Esp32AnalogWriter(kPin, Esp32AnalogWriter::kAutoSelectChan, 1000);
+    auto c = Esp32AnalogWriter(kPin, Esp32AnalogWriter::kAutoSelectChan, 5000);
+    auto d =
+        Esp32AnalogWriter(kPin, Esp32AnalogWriter::kAutoSelectChan, 5000, 12);
+    REQUIRE(a.chan() == 0);
+    REQUIRE(b.chan() == 2);  // timer of channel 1 runs with 5000 Hz
+    REQUIRE(c.chan() == 1);
+    REQUIRE(d.chan() == 4);
+
+    // all timers in use with other settings
+    std::vector<Esp32AnalogWriter> writers;
+    writers.reserve(8);
+    for (uint16_t freq = 100; freq < 600; freq += 100) {
+        writers.emplace_back(kPin, Esp32AnalogWriter::kAutoSelectChan, freq);
+    }
+    REQUIRE(Esp32AnalogWriter::allocator().num_free() == 7);
+    REQUIRE_FALSE(Esp32AnalogWriter(kPin, Esp32AnalogWriter::kAutoSelectChan,
+                                    2000).valid());
+    REQUIRE(Esp32AnalogWriter(kPin, Esp32AnalogWriter::kAutoSelectChan, 1000)
+                .chan() == 3);
+}
+
+TEST_CASE("ledc channel is not claimed if its timer runs with other settings",
+          "[esp32_analog_writer]") {
+    arduinoMockInit();
     constexpr auto kPin = 10;
+    constexpr auto kChan = 6;
+    constexpr auto kSibling = 7;
 
-    // note: we test a static property here (auto incremented next channel
-    // number). so test has side effects. TODO avoid?
-    for (auto i = 0; i < 20; i++) {
-        auto aw = Esp32AnalogWriter(kPin);
-        // there are 16 channels and the auto selected channel is expected
-        // to wrap over
-        REQUIRE(aw.chan() == i % 16);
+    auto a = Esp32AnalogWriter(kPin, kChan, 5000, 10);
+    REQUIRE(a.valid());
+    REQUIRE(arduinoMockGetLedcSetup(kChan).freq == 5000);
+
+    // other frequency or resolution on the same timer: refused, the timer
+    // keeps its settings.
+    REQUIRE_FALSE(Esp32AnalogWriter(kPin + 1, kSibling, 1000, 10).valid());
+    REQUIRE_FALSE(Esp32AnalogWriter(kPin + 1, kSibling, 5000, 8).valid());
+    REQUIRE_FALSE(Esp32AnalogWriter(kPin + 1, kChan, 1000, 10).valid());
+    REQUIRE(arduinoMockGetLedcSetup(kChan).freq == 5000);
+    REQUIRE(arduinoMockGetLedcSetup(kChan).bit_num == 10);
+    REQUIRE(arduinoMockGetLedcSetup(kSibling).freq == 0);
+    REQUIRE(arduinoMockGetLedcAttachPin(kPin + 1) == 0);
+
+    // same settings: the channel shares the timer, which is not set up again
+    auto b = Esp32AnalogWriter(kPin + 1, kSibling, 5000, 10);
+    REQUIRE(b.valid());
+    REQUIRE(b.chan() == kSibling);
+    REQUIRE(arduinoMockGetLedcSetup(kSibling).freq == 0);
+    REQUIRE(arduinoMockGetLedcAttachPin(kPin + 1) == kSibling);
+}
+
+TEST_CASE("ledc channel is released with the last copy of the writer",
+          "[esp32_analog_writer]") {
+    arduinoMockInit();
+    constexpr auto kPin = 10;
+    {
+        JLed led = JLed(Esp32AnalogWriter(kPin)).On();
+        REQUIRE(Esp32AnalogWriter::allocator().refs(0) == 1);
+        JLed copy = led;
+        REQUIRE(Esp32AnalogWriter::allocator().refs(0) == 2);
+        led = JLed(Esp32AnalogWriter(kPin + 1));
+        REQUIRE(Esp32AnalogWriter::allocator().refs(0) == 1);
+        REQUIRE(Esp32AnalogWriter::allocator().refs(1) == 1);
+        REQUIRE(arduinoMockGetLedcAttachPin(kPin) == 0);
     }
+    REQUIRE(Esp32AnalogWriter::allocator().num_free() == 16);
+    REQUIRE(arduinoMockGetLedcAttachPin(kPin) == LEDC_MOCK_DETACHED);
+    REQUIRE(arduinoMockGetLedcAttachPin(kPin + 1) == LEDC_MOCK_DETACHED);
 }
 
 TEST_CASE("ledc analogWrite() writes correct value", "[esp32_analog_writer]") {
@@ -45,3 +144,170 @@ TEST_CASE("ledc analogWrite() writes correct value", "[esp32_analog_writer]") {
     // note: value is written to channel, not pin.
     REQUIRE(arduinoMockGetLedcState(kChan) == 123);
 }
+
+TEST_CASE("ledc uses configured resolution", "[esp32_analog_writer]") {
+    arduinoMockInit();
+
+    constexpr auto kChan = 5;
+    constexpr auto kPin = 10;
+    auto aw = Esp32AnalogWriter(kPin, kChan, 1000, 12);
+    REQUIRE(aw.resolution() == 12);
+    REQUIRE(arduinoMockGetLedcSetup(kChan).freq == 1000);
+    REQUIRE(arduinoMockGetLedcSetup(kChan).bit_num == 12);
+
+    // 8 bit values are scaled up, keeping 0 and full brightness
+    aw.analogWrite(0);
+    REQUIRE(arduinoMockGetLedcState(kChan) == 0);
+    aw.analogWrite(255);
+    REQUIRE(arduinoMockGetLedcState(kChan) == 4095);
+    aw.analogWrite(128);
+    REQUIRE(arduinoMockGetLedcState(kChan) == (128 << 4) + 8);
+
+    // 16 bit values are reduced to the native resolution
+    aw.analogWrite16(0);
+    REQUIRE(arduinoMockGetLedcState(kChan) == 0);
+    aw.analogWrite16(1 << 4);
+    REQUIRE(arduinoMockGetLedcState(kChan) == 1);
+    aw.analogWrite16(0x8000);
+    REQUIRE(arduinoMockGetLedcState(kChan) == 2048);
+    aw.analogWrite16(65535);
+    REQUIRE(arduinoMockGetLedcState(kChan) == 4095);
+}
+
+TEST_CASE("properly scale 8bit to ledc resolution", "[esp32_analog_writer]") {
+    class TestableWriter : public Esp32AnalogWriter {
+     public:
+        static void test() {
+            for (auto bits = 8; bits <= 16; bits++) {
+                const uint32_t max = (1 << bits) - 1;
+                REQUIRE(ScaleFrom8Bit(0, bits) == 0);
+                REQUIRE(ScaleFrom8Bit(255, bits) == max);
+                for (auto i = 1; i < 256; i++) {
+                    REQUIRE(ScaleFrom8Bit(i, bits) >
+                            ScaleFrom8Bit(i - 1, bits));
+                }
+            }
+        }
+    };
+    TestableWriter::test();
+}
+
+TEST_CASE("analogFade16() starts hardware fade", "[esp32_analog_writer]") {
+    arduinoMockInit();
+    constexpr auto kPin = 10;
+
+    auto aw = Esp32AnalogWriter(kPin, 3, 5000, 12);
+    aw.analogFade16(0x8000, 500);
+    REQUIRE(arduinoMockGetLedcFade(3).count == 1);
+    REQUIRE(arduinoMockGetLedcFade(3).target_duty == 2048);
+    REQUIRE(arduinoMockGetLedcFade(3).time_ms == 500);
+
+    // low speed channel
+    auto aw2 = Esp32AnalogWriter(kPin, 11);
+    aw2.analogFade16(0xffff, 100);
+    REQUIRE(arduinoMockGetLedcFade(11).count == 1);
+    REQUIRE(arduinoMockGetLedcFade(11).target_duty == 255);
+    REQUIRE(arduinoMockGetLedcWriteCount(3) == 0);
+    REQUIRE(arduinoMockGetLedcWriteCount(11) == 0);
+}
+
+TEST_CASE("FadeOn() with HardwareFade() is offloaded to ledc",
+          "[esp32_analog_writer]") {
+    arduinoMockInit();
+    constexpr auto kPin = 10;
+    constexpr auto kChan = 4;
+    constexpr auto kSegments =
+        JLedFadeOnTable<JLED_FADE_ON_TABLE_SIZE>::kSize - 1;
+
+    auto led = JLed16(Esp32AnalogWriter(kPin, kChan, 5000, 12))
+                   .FadeOn(5000)
+                   .HardwareFade();
+
+    // the start value is written once, then the first segment is faded
+    // to its target, which is what the LED outputs at the end of the
+    // segment without hardware fade.
+    led.Update(0);
+    const auto end = led.NextUpdateTime();
+    REQUIRE(end > 0);
+    REQUIRE(arduinoMockGetLedcWriteCount(kChan) == 1);
+    REQUIRE(arduinoMockGetLedcFade(kChan).count == 1);
+    REQUIRE(arduinoMockGetLedcFade(kChan).time_ms == end);
+
+    constexpr auto kRefChan = 5;
+    auto ref = JLed16(Esp32AnalogWriter(kPin + 1, kRefChan, 5000, 12))
+                   .FadeOn(5000);
+    ref.Update(0);
+    ref.Update(end);
+    REQUIRE(arduinoMockGetLedcFade(kChan).target_duty ==
+            arduinoMockGetLedcState(kRefChan));
+
+    for (uint32_t t = 1; t <= 5000; t++) led.Update(t);
+
+    // a handful of fades instead of thousands of writes
+    REQUIRE(arduinoMockGetLedcFade(kChan).count == kSegments);
+    REQUIRE(arduinoMockGetLedcWriteCount(kChan) == 1);
+    REQUIRE(arduinoMockGetLedcState(kChan) == 4095);
+}
+
+TEST_CASE("Stop() during a hardware fade turns the LED off",
+          "[esp32_analog_writer]") {
+    arduinoMockInit();
+    constexpr auto kPin = 10;
+    constexpr auto kChan = 4;
+
+    auto led = JLed16(Esp32AnalogWriter(kPin, kChan, 5000, 12))
+                   .FadeOff(5000)
+                   .HardwareFade();
+    led.Update(0);
+    led.Update(10);
+    REQUIRE(arduinoMockGetLedcWriteCount(kChan) == 1);
+    REQUIRE(arduinoMockGetLedcFade(kChan).count == 1);
+
+    // the running fade may still be far from its target, so 0 is written
+    // even if it equals the target of the fade.
+    led.Stop();
+    REQUIRE(arduinoMockGetLedcWriteCount(kChan) == 2);
+    REQUIRE(arduinoMockGetLedcState(kChan) == 0);
+
+    // a fade to 0, interrupted by Stop()
+    auto led2 = JLed16(Esp32AnalogWriter(kPin, kChan + 1, 5000, 12))
+                    .FadeOff(5000)
+                    .HardwareFade();
+    for (uint32_t t = 0; t <= 4900; t += 100) led2.Update(t);
+    const auto writes = arduinoMockGetLedcWriteCount(kChan + 1);
+    REQUIRE(arduinoMockGetLedcFade(kChan + 1).target_duty == 0);
+    led2.Stop();
+    REQUIRE(arduinoMockGetLedcWriteCount(kChan + 1) == writes + 1);
+    REQUIRE(arduinoMockGetLedcState(kChan + 1) == 0);
+}
+
+TEST_CASE("ledc resolution is limited by the frequency",
+          "[esp32_analog_writer]") {
+    arduinoMockInit();
+    constexpr auto kPin = 10;
+    constexpr auto kChan = 6;
+
+    REQUIRE(Esp32AnalogWriter::MaxResolution(1000) == 16);
+    REQUIRE(Esp32AnalogWriter::MaxResolution(5000) == 13);
+    REQUIRE(Esp32AnalogWriter::MaxResolution(20000) == 11);
+    REQUIRE(Esp32AnalogWriter::MaxResolution(25000) == 11);
+    REQUIRE(Esp32AnalogWriter::MaxResolution(40000) == 10);
+
+    // valid combinations are used as given
+    REQUIRE(Esp32AnalogWriter(kPin, kChan, 1000, 14).resolution() == 14);
+    REQUIRE(arduinoMockGetLedcSetup(kChan).bit_num == 14);
+    REQUIRE(Esp32AnalogWriter(kPin, kChan, 20000, 8).resolution() == 8);
+
+    // too high resolutions are reduced, too low ones raised to 8 bits
+    auto aw = Esp32AnalogWriter(kPin, kChan, 20000, 14);
+    REQUIRE(aw.resolution() == 11);
+    REQUIRE(arduinoMockGetLedcSetup(kChan).freq == 20000);
+    REQUIRE(arduinoMockGetLedcSetup(kChan).bit_num == 11);
+    REQUIRE(Esp32AnalogWriter(kPin, kChan, 1000, 4).resolution() == 8);
+
+    // values are scaled to the resolution actually used
+    aw.analogWrite(255);
+    REQUIRE(arduinoMockGetLedcState(kChan) == 2047);
+    aw.analogWrite16(0x8000);
+    REQUIRE(arduinoMockGetLedcState(kChan) == 1024);
+}
@@ -30,3 +30,20 @@ TEST_CASE("analogWrite() writes correct value", "[esp8266_analog_writer]") {
     REQUIRE(arduinoMockGetPinState(kPin) == (123<<2)+3);
 }
 
+
+TEST_CASE("analogWrite16() reduces 16bit to 10bit",
+          "[esp8266_analog_writer]") {
+    arduinoMockInit();
+
+    constexpr auto kPin = 10;
+    auto aw = Esp8266AnalogWriter(kPin);
+
+    aw.analogWrite16(0);
+    REQUIRE(arduinoMockGetPinState(kPin) == 0);
+    aw.analogWrite16(1 << 6);
+    REQUIRE(arduinoMockGetPinState(kPin) == 1);
+    aw.analogWrite16(123 << 6);
+    REQUIRE(arduinoMockGetPinState(kPin) == 123);
+    aw.analogWrite16(65535);
+    REQUIRE(arduinoMockGetPinState(kPin) == 1023);
+}
@@ -2,6 +2,7 @@
 // an Arduino mock for testing.
 // Copyright 2017 Jan Delgado jdelgado@gmx.net
 #include <map>
+#include <set>
 #include <vector>
 
 #define CATCH_CONFIG_MAIN
@@ -16,13 +17,13 @@ TEST_CASE("jled ctor set pin mode to OUTPUT", "[jled]") {
     REQUIRE(arduinoMockGetPinMode(kTestPin) == OUTPUT);
 }
 
-TEST_CASE("properly initialize brightness_func", "[jled]") {
+TEST_CASE("properly initialize effect", "[jled]") {
     class TestableJLed : public JLed {
      public:
         using JLed::JLed;
         static void test() {
             TestableJLed jled = TestableJLed(1);
-            REQUIRE(jled.brightness_func_ == nullptr);
+            REQUIRE(jled.effect_.func() == nullptr);
         }
     };
     TestableJLed::test();
@@ -36,25 +37,25 @@ TEST_CASE("On/Off function configuration", "[jled]") {
             SECTION("On()") {
                 TestableJLed jled(1);
                 jled.On();
-                REQUIRE(jled.brightness_func_ == &JLed::OnFunc);
+                REQUIRE(jled.effect_.func() == &JLed::OnFunc);
             }
 
             SECTION("Off()") {
                 TestableJLed jled(1);
                 jled.Off();
-                REQUIRE(jled.brightness_func_ == &JLed::OffFunc);
+                REQUIRE(jled.effect_.func() == &JLed::OffFunc);
             }
 
             SECTION("Set(true)") {
                 TestableJLed jled(1);
                 jled.Set(true);
-                REQUIRE(jled.brightness_func_ == &JLed::OnFunc);
+                REQUIRE(jled.effect_.func() == &JLed::OnFunc);
             }
 
             SECTION("Set(false)") {
                 TestableJLed jled(1);
                 jled.Set(false);
-                REQUIRE(jled.brightness_func_ == &JLed::OffFunc);
+                REQUIRE(jled.effect_.func() == &JLed::OffFunc);
             }
         }
     };
@@ -68,7 +69,7 @@ TEST_CASE("Breathe() function configuration", "[jled]") {
         static void test() {
             TestableJLed jled(1);
             jled.Breathe(0);
-            REQUIRE(jled.brightness_func_ == &JLed::BreatheFunc);
+            REQUIRE(jled.effect_.func() == &JLed::BreatheFunc);
         }
     };
     TestableJLed::test();
@@ -81,12 +82,12 @@ TEST_CASE("FadeOn()/FadeOff() function configuration", "[jled]") {
         static void testFadeOff() {
             TestableJLed jled(1);
             jled.FadeOff(0);
-            REQUIRE(jled.brightness_func_ == &JLed::FadeOffFunc);
+            REQUIRE(jled.effect_.func() == &JLed::FadeOffFunc);
         }
         static void testFadeOn() {
             TestableJLed jled(1);
             jled.FadeOn(0);
-            REQUIRE(jled.brightness_func_ == &JLed::FadeOnFunc);
+            REQUIRE(jled.effect_.func() == &JLed::FadeOnFunc);
         }
     };
     TestableJLed::testFadeOn();
@@ -252,6 +253,68 @@ TEST_CASE("LowActive() inverts signal", "[jled]") {
     REQUIRE(arduinoMockGetPinState(kTestPin) == 255);
 }
 
+TEST_CASE("lightness table maps perceived to physical brightness", "[jled]") {
+    REQUIRE(JLedLightnessTable::Lookup(0) == 0);
+    REQUIRE(JLedLightnessTable::Lookup(255) == 255);
+    for (auto i = 0; i < 256; i++) {
+        const auto l = 100. * i / 255.;
+        const auto y = (l <= 8.) ? l / 903.3 : pow((l + 16.) / 116., 3);
+        REQUIRE(JLedLightnessTable::Lookup(i) ==
+                static_cast<uint8_t>(y * 255. + .5));
+        if (i > 0) {
+            REQUIRE(JLedLightnessTable::Lookup(i) >=
+                    JLedLightnessTable::Lookup(i - 1));
+        }
+    }
+}
+
+static uint8_t ConstantFunc(uint32_t, uint16_t, uintptr_t param) {
+    return param;
+}
+
+TEST_CASE("Perceptual() corrects output and composes with Invert() and "
+          "LowActive()", "[jled]") {
+    constexpr auto kTestPin = 10;
+    auto output = [](JLed& led) {
+        led.Update();
+        return arduinoMockGetPinState(kTestPin);
+    };
+    const auto lightness_64 = JLedLightnessTable::Value(64);
+    const auto lightness_191 = JLedLightnessTable::Value(191);
+    REQUIRE(lightness_64 == 11);
+    REQUIRE(lightness_191 == 123);
+    arduinoMockInit();
+
+    JLed led = JLed(kTestPin).UserFunc(ConstantFunc, 1, 64);
+    REQUIRE_FALSE(led.IsPerceptual());
+    REQUIRE(output(led) == 64);
+
+    led = JLed(kTestPin).UserFunc(ConstantFunc, 1, 64).Perceptual();
+    REQUIRE(led.IsPerceptual());
+    REQUIRE(output(led) == lightness_64);
+
+    // inverting the effect inverts the perceived brightness
+    led = JLed(kTestPin).UserFunc(ConstantFunc, 1, 64).Invert().Perceptual();
+    REQUIRE(output(led) == lightness_191);
+
+    // low active inverts the physical output
+    led = JLed(kTestPin).UserFunc(ConstantFunc, 1, 64).LowActive().Perceptual();
+    REQUIRE(output(led) == 255 - lightness_64);
+
+    led = JLed(kTestPin)
+              .UserFunc(ConstantFunc, 1, 64)
+              .Invert()
+              .LowActive()
+              .Perceptual();
+    REQUIRE(output(led) == 255 - lightness_191);
+
+    // off stays off
+    led = JLed(kTestPin).FadeOn(100).Perceptual();
+    REQUIRE(output(led) == 0);
+    led.Stop();
+    REQUIRE(arduinoMockGetPinState(kTestPin) == 0);
+}
+
 TEST_CASE("blink led twice with delay and repeat", "[jled]") {
     constexpr auto kTestPin = 10;
     arduinoMockInit();
@@ -317,6 +380,37 @@ TEST_CASE("Update returns true while updating, else false", "[jled]") {
     REQUIRE_FALSE(jled.Update());
 }
 
+TEST_CASE("effects with zero length cycle end immediately", "[jled]") {
+    constexpr auto kTestPin = 10;
+    arduinoMockInit();
+
+    SECTION("FadeOn(0) is done after the first update") {
+        JLed jled = JLed(kTestPin).FadeOn(0);
+        REQUIRE_FALSE(jled.Update(0));
+        REQUIRE(arduinoMockGetPinState(kTestPin) == 255);
+        REQUIRE_FALSE(jled.Update(1));
+    }
+
+    SECTION("UserFunc() with period 0 and Repeat(0) are done") {
+        auto user_func = [](uint32_t, uint16_t, uintptr_t) -> uint8_t {
+            return 77;
+        };
+        JLed jled = JLed(kTestPin).UserFunc(user_func, 0, 0);
+        REQUIRE_FALSE(jled.Update(0));
+        JLed jled2 = JLed(kTestPin).Blink(10, 10).Repeat(0);
+        REQUIRE_FALSE(jled2.Update(0));
+    }
+
+    SECTION("Blink(0, 0).Forever() keeps running") {
+        JLed jled = JLed(kTestPin).Blink(0, 0).Forever();
+        for (uint32_t t = 0; t < 10; t++) {
+            REQUIRE(jled.Update(t));
+            REQUIRE(jled.NextUpdateTime() == t);
+        }
+        REQUIRE(arduinoMockGetPinState(kTestPin) == 0);
+    }
+}
+
 TEST_CASE("user provided brightness function", "[jled]") {
     constexpr auto kTestPin = 10;
     constexpr auto kDuration = 5;
@@ -341,3 +435,1006 @@ TEST_CASE("user provided brightness function", "[jled]") {
     }
     jled.Update();
 }
+
+TEST_CASE("Update(now) uses the given time instead of millis()", "[jled]") {
+    constexpr auto kTestPin = 10;
+    arduinoMockInit();
+    JLed jled = JLed(kTestPin).Blink(2, 3);
+
+    // millis() stays at 0, time is solely provided by the caller.
+    const std::vector<uint8_t> expected = {255, 255, 0, 0, 0};
+    uint32_t time = 0;
+    for (const auto val : expected) {
+        REQUIRE(jled.Update(time++));
+        REQUIRE(arduinoMockGetPinState(kTestPin) == val);
+    }
+    REQUIRE_FALSE(jled.Update(time));
+    REQUIRE(millis() == 0);
+}
+
+TEST_CASE("UpdateAll() updates all LEDs with the same time tick", "[jled]") {
+    arduinoMockInit();
+    JLed leds[] = {JLed(1).Blink(1, 1), JLed(2).Blink(3, 1),
+                   JLed(3).Off().DelayBefore(1)};
+
+    SECTION("caller supplied time") {
+        REQUIRE(UpdateAll(leds, 3, 0));
+        REQUIRE(arduinoMockGetPinState(1) == 255);
+        REQUIRE(arduinoMockGetPinState(2) == 255);
+        REQUIRE(UpdateAll(leds, 3, 1));
+        REQUIRE(arduinoMockGetPinState(1) == 0);
+        REQUIRE(arduinoMockGetPinState(2) == 255);
+        REQUIRE(UpdateAll(leds, 3, 2));
+        // only second LED still active
+        REQUIRE(UpdateAll(leds, 3, 3));
+        REQUIRE(arduinoMockGetPinState(2) == 0);
+        REQUIRE_FALSE(UpdateAll(leds, 3, 4));
+    }
+
+    SECTION("time read from millis()") {
+        arduinoMockSetMillis(0);
+        REQUIRE(UpdateAll(leds, 3));
+        arduinoMockSetMillis(1);
+        REQUIRE(UpdateAll(leds, 3));
+        REQUIRE(arduinoMockGetPinState(1) == 0);
+        REQUIRE(arduinoMockGetPinState(2) == 255);
+    }
+}
+
+// a non-monotonic curve used in tests
+static const uint8_t kTestCurveTable[] JLED_PROGMEM = {0, 200, 50, 255, 10};
+static const JLedCurve kTestCurve = {kTestCurveTable, sizeof(kTestCurveTable)};
+
+TEST_CASE("EvalNextChange() never skips a change of brightness", "[jled]") {
+    class TestableJLed : public JLed {
+     public:
+        using JLed::JLed;
+        static void test() {
+            for (auto period : {1, 2, 3, 7, 100, 255, 256, 257, 1000, 2001}) {
+                TestableJLed leds[] = {TestableJLed(1), TestableJLed(1),
+                                       TestableJLed(1), TestableJLed(1),
+                                       TestableJLed(1), TestableJLed(1),
+                                       TestableJLed(1)};
+                leds[0].On();
+                leds[1].Off();
+                leds[2].Blink(period / 3, period - period / 3);
+                leds[3].FadeOn(period);
+                leds[4].FadeOff(period);
+                leds[5].Breathe(period);
+                leds[6].Curve(kTestCurve, period);
+                for (auto i = 0; i < 7; i++) {
+                    auto& jled = leds[i];
+                    // On() and Off() use a period of 1
+                    const uint32_t p = i < 2 ? 1 : period;
+                    for (uint32_t t = 0; t < p; t++) {
+                        const auto next = jled.EvalNextChange(t);
+                        REQUIRE(next > t);
+                        REQUIRE(next <= p);
+                        const auto val = jled.EvalBrightness(t);
+                        for (auto t1 = t + 1; t1 < next; t1++) {
+                            REQUIRE(jled.EvalBrightness(t1) == val);
+                        }
+                    }
+                }
+            }
+        }
+    };
+    TestableJLed::test();
+}
+
+TEST_CASE("NextUpdateTime() returns time of next change of output", "[jled]") {
+    arduinoMockInit();
+
+    SECTION("delay before, blink phases and delay after") {
+        JLed jled = JLed(1).Blink(10, 20).DelayBefore(100).DelayAfter(50);
+        REQUIRE(jled.Update(1000));
+        REQUIRE(jled.NextUpdateTime() == 1100);
+        REQUIRE(jled.Update(1100));
+        REQUIRE(jled.NextUpdateTime() == 1110);
+        REQUIRE(jled.Update(1110));
+        REQUIRE(jled.NextUpdateTime() == 1130);
+        REQUIRE(jled.Update(1130));
+        // delay after phase is capped by end of effect
+        REQUIRE(jled.NextUpdateTime() == 1180);
+        REQUIRE_FALSE(jled.Update(1180));
+    }
+
+    SECTION("next iteration after delay after phase") {
+        JLed jled = JLed(1).On().DelayAfter(50).Forever();
+        REQUIRE(jled.Update(0));
+        REQUIRE(jled.NextUpdateTime() == 1);
+        REQUIRE(jled.Update(1));
+        REQUIRE(jled.NextUpdateTime() == 51);
+    }
+
+    SECTION("slow fade needs much less than one update per tick") {
+        constexpr auto kPeriod = 5000;
+        JLed jled = JLed(1).FadeOn(kPeriod);
+        auto num_updates = 0;
+        uint32_t now = 0;
+        while (jled.Update(now)) {
+            num_updates++;
+            const auto next = jled.NextUpdateTime();
+            REQUIRE(next > now);
+            now = next;
+        }
+        // at most one update per scaled time step (256) plus the final value
+        REQUIRE(num_updates <= 257);
+        REQUIRE(arduinoMockGetPinState(1) == 255);
+    }
+
+    SECTION("user functions are updated every tick") {
+        auto func = [](uint32_t, uint16_t, uintptr_t) -> uint8_t { return 0; };
+        JLed jled = JLed(1).UserFunc(func, 100);
+        REQUIRE(jled.Update(10));
+        REQUIRE(jled.NextUpdateTime() == 11);
+    }
+}
+
+// user provided brightness function used with JLedStatic, which requires
+// the function to have linkage.
+static uint8_t StaticUserFunc(uint32_t t, uint16_t, uintptr_t param) {
+    return t + param;
+}
+
+TEST_CASE("static effect behaves like dynamic effect", "[jled]") {
+    constexpr auto kPinDynamic = 1;
+    constexpr auto kPinStatic = 2;
+    arduinoMockInit();
+
+    SECTION("built-in effect") {
+        JLed dynamic_led = JLed(kPinDynamic).Breathe(100).DelayAfter(10);
+        auto static_led = JLedStatic<&JLedEffects::BreatheFunc>(kPinStatic)
+                              .Breathe(100)
+                              .DelayAfter(10);
+        for (uint32_t now = 0; now < 120; now++) {
+            REQUIRE(dynamic_led.Update(now) == static_led.Update(now));
+            REQUIRE(arduinoMockGetPinState(kPinDynamic) ==
+                    arduinoMockGetPinState(kPinStatic));
+            REQUIRE(dynamic_led.NextUpdateTime() ==
+                    static_led.NextUpdateTime());
+        }
+    }
+
+    SECTION("user provided function and Stop()") {
+        auto static_led = JLedStatic<&StaticUserFunc>(kPinStatic)
+                              .UserFunc<&StaticUserFunc>(10, 100);
+        REQUIRE(static_led.Update(0));
+        REQUIRE(arduinoMockGetPinState(kPinStatic) == 100);
+        REQUIRE(static_led.Update(5));
+        REQUIRE(arduinoMockGetPinState(kPinStatic) == 105);
+        static_led.Stop();
+        REQUIRE(arduinoMockGetPinState(kPinStatic) == 0);
+        REQUIRE_FALSE(static_led.Update(6));
+    }
+}
+
+TEST_CASE("ScaleToByte() variants calculate (t << 8) / period", "[jled]") {
+    class TestableJLed : public JLed {
+     public:
+        static void test() {
+            for (uint32_t period : {1, 2, 3, 255, 256, 257, 1000, 65535}) {
+                for (uint32_t t = 0; t < period; t += 1 + period / 1000) {
+                    REQUIRE(JLed::ScaleToByte(t, period) == (t << 8) / period);
+                    REQUIRE(JLed::ScaleToByteShiftSubtract(t, period) ==
+                            (t << 8) / period);
+                }
+                REQUIRE(JLed::ScaleToByteShiftSubtract(period - 1, period) ==
+                        ((period - 1) << 8) / period);
+            }
+        }
+    };
+    TestableJLed::test();
+}
+
+TEST_CASE("DelayBefore() starts effect at the start time", "[jled]") {
+    constexpr auto kTestPin = 10;
+    arduinoMockInit();
+    auto jled = JLed(kTestPin).Blink(10, 10).DelayBefore(100).Forever();
+
+    REQUIRE(jled.Update(1000));
+    REQUIRE(jled.NextUpdateTime() == 1100);
+    REQUIRE(jled.Update(1099));
+    REQUIRE(arduinoMockGetAnalogWriteCount(kTestPin) == 0);
+
+    SECTION("update at the start time") {
+        REQUIRE(jled.Update(1100));
+        REQUIRE(arduinoMockGetPinState(kTestPin) == 255);
+        REQUIRE(jled.NextUpdateTime() == 1110);
+    }
+
+    SECTION("updates skipping the start time continue the effect") {
+        REQUIRE(jled.Update(1115));
+        REQUIRE(arduinoMockGetPinState(kTestPin) == 0);
+        REQUIRE(jled.Update(1120));
+        REQUIRE(arduinoMockGetPinState(kTestPin) == 255);
+    }
+
+    SECTION("DelayBefore() pauses a running effect") {
+        REQUIRE(jled.Update(1105));
+        jled.DelayBefore(50);
+        // the pause is counted from the last update, then the effect
+        // continues at t=5.
+        REQUIRE(jled.Update(1106));
+        REQUIRE(jled.NextUpdateTime() == 1155);
+        REQUIRE(jled.Update(1154));
+        REQUIRE(arduinoMockGetPinState(kTestPin) == 255);
+        REQUIRE(jled.Update(1159));
+        REQUIRE(arduinoMockGetPinState(kTestPin) == 255);
+        REQUIRE(jled.Update(1160));
+        REQUIRE(arduinoMockGetPinState(kTestPin) == 0);
+    }
+}
+
+TEST_CASE("effects are not affected by the wrap around of millis()",
+          "[jled]") {
+    constexpr auto kTestPin = 10;
+    constexpr auto kRefPin = 11;
+
+    // runs led and ref for duration ms with Update(), led starting at
+    // time start, ref at time 0, and checks that both output the same.
+    auto compare = [](JLed led, JLed ref, uint32_t start, uint32_t duration) {
+        arduinoMockInit();
+        for (uint32_t t = 0; t < duration; t++) {
+            INFO("start=" << start << " t=" << t);
+            arduinoMockSetMillis(start + t);
+            const auto active = led.Update();
+            REQUIRE(active == ref.Update(t));
+            if (active) {
+                REQUIRE(led.NextUpdateTime() - start == ref.NextUpdateTime());
+            }
+            REQUIRE(arduinoMockGetPinState(kTestPin) ==
+                    arduinoMockGetPinState(kRefPin));
+        }
+    };
+
+    // start times, such that the wrap happens at different points of the
+    // effect, including the start time itself.
+    for (const uint32_t offset : {1, 2, 50, 99, 100, 101, 150, 420}) {
+        const uint32_t start = UINT32_MAX - offset + 1;
+        compare(JLed(kTestPin).Blink(100, 100).DelayAfter(50).Forever(),
+                JLed(kRefPin).Blink(100, 100).DelayAfter(50).Forever(), start,
+                1000);
+        compare(JLed(kTestPin).Breathe(200).DelayAfter(50).Repeat(2),
+                JLed(kRefPin).Breathe(200).DelayAfter(50).Repeat(2), start,
+                1000);
+        compare(JLed(kTestPin).FadeOn(300).DelayBefore(100),
+                JLed(kRefPin).FadeOn(300).DelayBefore(100), start, 1000);
+    }
+}
+
+TEST_CASE("JLedIteration advances position and counts iterations",
+          "[jled]") {
+    uint32_t t = 3;
+    uint16_t iteration = 0;
+    // within the iteration of 5 ticks
+    REQUIRE_FALSE(JLedIteration::Advance(&t, 5, 1, &iteration, 3));
+    REQUIRE(t == 4);
+    // wrap by subtraction
+    REQUIRE(JLedIteration::Advance(&t, 5, 1, &iteration, 3));
+    REQUIRE(t == 0);
+    REQUIRE(iteration == 1);
+    // skipping one complete iteration
+    REQUIRE(JLedIteration::Advance(&t, 5, 12, &iteration, 3));
+    REQUIRE(t == 2);
+    REQUIRE(iteration == 3);
+    REQUIRE(JLedIteration::IsDone(iteration, 3));
+
+    SECTION("counter saturates with 32 bit durations and deltas") {
+        t = 0xfffffff0;
+        iteration = 65000;
+        REQUIRE(JLedIteration::Advance(&t, 0xffffffff, 0xffffffff,
+                                       &iteration, 65534));
+        REQUIRE(t == 0xfffffff0);  // exactly one iteration later
+        REQUIRE(iteration == 65001);
+        REQUIRE(JLedIteration::Advance(&t, 1, 0xffffffff, &iteration, 65534));
+        REQUIRE(iteration == 65534);
+    }
+
+    SECTION("Forever() is not counted") {
+        iteration = 0;
+        REQUIRE(JLedIteration::Advance(&t, 5, 100, &iteration,
+                                       JLedIteration::kRepeatForever));
+        REQUIRE(iteration == 0);
+        REQUIRE_FALSE(
+            JLedIteration::IsDone(iteration, JLedIteration::kRepeatForever));
+    }
+}
+
+TEST_CASE("phase tracking handles updates skipping iterations", "[jled]") {
+    constexpr auto kTestPin = 10;
+    arduinoMockInit();
+    // 1 ms on, 2 ms off, 2 ms delay after, i.e. 5 ms per iteration
+    JLed jled = JLed(kTestPin).Blink(1, 2).DelayAfter(2).Forever();
+
+    // (time, expected value)
+    const std::vector<std::pair<uint32_t, uint8_t>> expected = {
+        {0, 255}, {1, 0}, {5, 255}, {11, 0}, {20, 255}, {1000, 255},
+        {1003, 0}, {1006, 0}, {1010, 255}};
+    for (const auto& x : expected) {
+        jled.Update(x.first);
+        REQUIRE(arduinoMockGetPinState(kTestPin) == x.second);
+    }
+
+    SECTION("end of effect is detected when iterations are skipped") {
+        jled.FadeOff(100).DelayAfter(50).Repeat(3);
+        REQUIRE(jled.Update(2000));
+        REQUIRE(jled.Update(2300));  // start of 3rd iteration
+        REQUIRE(arduinoMockGetPinState(kTestPin) == 255);
+        REQUIRE_FALSE(jled.Update(5000));
+        REQUIRE(arduinoMockGetPinState(kTestPin) == 0);
+    }
+
+    SECTION("repetition count does not overflow when skipping 2^32 ms") {
+        jled.Blink(1, 1).DelayAfter(0).Repeat(60000);
+        REQUIRE(jled.Update(0));
+        REQUIRE(jled.Update(3));  // 1 iteration completed
+        REQUIRE_FALSE(jled.Update(2));
+    }
+}
+
+TEST_CASE("JLedLong runs effects with 32 bit durations", "[jled]") {
+    constexpr auto kTestPin = 10;
+    arduinoMockInit();
+
+    SECTION("one hour fade keeps the shape of a short fade") {
+        constexpr uint32_t kHour = 3600000;
+        auto led = JLedLong(kTestPin).FadeOn(kHour);
+        auto ref = JLed(kTestPin + 1).FadeOn(1000);
+        for (uint32_t t = 0; t < 1000; t++) {
+            REQUIRE(led.Update(t * (kHour / 1000)));
+            ref.Update(t);
+            // both round differently between the points of the fade table
+            REQUIRE(abs(arduinoMockGetPinState(kTestPin) -
+                        arduinoMockGetPinState(kTestPin + 1)) <= 2);
+        }
+        REQUIRE(led.Update(kHour - 1));
+        REQUIRE_FALSE(led.Update(kHour));
+        REQUIRE(arduinoMockGetPinState(kTestPin) == 255);
+    }
+
+    SECTION("long blinks and delays are repeated") {
+        // 100 s on, 200 s off, 10 min delay after, 3 times
+        auto led = JLedLong(kTestPin)
+                       .Blink(100000, 200000)
+                       .DelayAfter(600000)
+                       .DelayBefore(70000)
+                       .Repeat(3);
+        // (time, expected value)
+        const std::vector<std::pair<uint32_t, uint8_t>> expected = {
+            {0, 0},         {70000, 255},   {169999, 255}, {170000, 0},
+            {969999, 0},    {970000, 255},  {1070000, 0},  {1870000, 255}};
+        for (const auto& x : expected) {
+            REQUIRE(led.Update(x.first));
+            REQUIRE(arduinoMockGetPinState(kTestPin) == x.second);
+        }
+        REQUIRE(led.NextUpdateTime() == 1970000);
+        REQUIRE_FALSE(led.Update(2770000));
+    }
+
+    SECTION("on-time of long blinks is rounded to the period granularity") {
+        // period 300007 is scaled by 3 bits, i.e. steps of 8 ms, so the
+        // on-time of 100007 ms is rounded to 100008 ms.
+        auto led = JLedLong(kTestPin).Blink(100007, 200000);
+        REQUIRE(led.Update(0));
+        REQUIRE(led.NextUpdateTime() == 100008);
+        REQUIRE(led.Update(100007));
+        REQUIRE(arduinoMockGetPinState(kTestPin) == 255);
+        REQUIRE(led.Update(100008));
+        REQUIRE(arduinoMockGetPinState(kTestPin) == 0);
+
+        // rounding up does not overflow the scaled on-time
+        auto on = JLedLong(kTestPin).Blink(0x1ffff, 0);
+        REQUIRE(on.Update(0));
+        REQUIRE(arduinoMockGetPinState(kTestPin) == 255);
+        REQUIRE(on.Update(0x1fffd));
+        REQUIRE(arduinoMockGetPinState(kTestPin) == 255);
+    }
+}
+
+TEST_CASE("unchanged values are not written again", "[jled]") {
+    constexpr auto kTestPin = 10;
+
+    // run the LED for duration ms and return the number of analogWrite()
+    // calls to the pin.
+    auto count_writes = [](JLed jled, uint32_t duration) {
+        arduinoMockInit();
+        for (uint32_t now = 0; now < duration; now++) jled.Update(now);
+        return arduinoMockGetAnalogWriteCount(kTestPin);
+    };
+
+    // On() and Off() are written exactly once
+    REQUIRE(count_writes(JLed(kTestPin).On().Forever(), 1000) == 1);
+    REQUIRE(count_writes(JLed(kTestPin).Off().Forever(), 1000) == 1);
+    // one on and one off write per blink
+    REQUIRE(count_writes(JLed(kTestPin).Blink(100, 100).Forever(), 1000) ==
+            10);
+    // a slow fade changes brightness at most 256 times
+    REQUIRE(count_writes(JLed(kTestPin).FadeOn(5000), 5000) <= 256);
+    REQUIRE(count_writes(JLed(kTestPin).Breathe(5000), 5000) <= 2 * 256);
+    // low active LEDs are elided the same way
+    REQUIRE(count_writes(JLed(kTestPin).On().LowActive().Forever(), 1000) ==
+            1);
+}
+
+TEST_CASE("new effect is always written", "[jled]") {
+    constexpr auto kTestPin = 10;
+    arduinoMockInit();
+    JLed jled = JLed(kTestPin).Off();
+    jled.Update(0);
+    REQUIRE(arduinoMockGetAnalogWriteCount(kTestPin) == 1);
+    jled.Off();
+    jled.Update(1);
+    REQUIRE(arduinoMockGetAnalogWriteCount(kTestPin) == 2);
+    // Stop() does not write when LED is already off
+    jled.Stop();
+    REQUIRE(arduinoMockGetAnalogWriteCount(kTestPin) == 2);
+}
+
+TEST_CASE("size of JLed", "[jled]") {
+    // pin the size of JLed objects on the host, so that changes to the
+    // memory layout are noticed. See also size budget in jled.h for the
+    // target platforms (23 bytes on AVR, 28 bytes on ESP8266 and ESP32).
+    constexpr auto kPtrSize = sizeof(void*);
+    REQUIRE(sizeof(JLed) == (kPtrSize == 8 ? 40 : 28));
+    REQUIRE(sizeof(JLedStatic<&JLedEffects::BreatheFunc>) ==
+            (kPtrSize == 8 ? 32 : 24));
+    // the 16 bit last value fits into the padding
+    REQUIRE(sizeof(JLed16) == sizeof(JLed));
+}
+
+TEST_CASE("JLedMicros uses micros() and 32 bit durations", "[jled]") {
+    constexpr auto kTestPin = 10;
+    arduinoMockInit();
+
+    SECTION("Update() reads micros()") {
+        auto led = JLedMicros(kTestPin).Blink(200, 300).Forever();
+        arduinoMockSetMillis(1000);
+        for (uint32_t now = 0; now < 1000; now += 50) {
+            arduinoMockSetMicros(now);
+            REQUIRE(led.Update());
+            REQUIRE(arduinoMockGetPinState(kTestPin) ==
+                    (now % 500 < 200 ? 255 : 0));
+        }
+        // start of the next blink after the off phase at 950 us
+        REQUIRE(led.NextUpdateTime() == 1000);
+    }
+
+    SECTION("periods exceeding 16 bits keep the shape of the effect") {
+        // a 1 s fade in us, compared to the same fade in ms
+        auto led = JLedMicros(kTestPin).FadeOn(1000000);
+        auto ref = JLed(kTestPin + 1).FadeOn(1000);
+        for (uint32_t t = 0; t < 1000; t += 10) {
+            led.Update(t * 1000);
+            ref.Update(t);
+            REQUIRE(abs(arduinoMockGetPinState(kTestPin) -
+                        arduinoMockGetPinState(kTestPin + 1)) <= 1);
+        }
+        REQUIRE(led.Update(999999));
+        REQUIRE(arduinoMockGetPinState(kTestPin) == 255);
+        REQUIRE_FALSE(led.Update(1000000));
+    }
+
+    SECTION("long delays") {
+        auto led = JLedMicros(kTestPin).On().DelayBefore(100000);
+        REQUIRE(led.Update(0));
+        REQUIRE(led.NextUpdateTime() == 100000);
+        REQUIRE(led.Update(99999));
+        REQUIRE(arduinoMockGetAnalogWriteCount(kTestPin) == 0);
+        REQUIRE(led.Update(100000));
+        REQUIRE(arduinoMockGetPinState(kTestPin) == 255);
+    }
+}
+
+static uint32_t rtc_now = 0;
+static uint32_t rtcMillis() { return rtc_now; }
+
+TEST_CASE("clock policy provides the time of Update()", "[jled]") {
+    constexpr auto kTestPin = 10;
+    arduinoMockInit();
+
+    SECTION("frame clock reads millis() only on Tick()") {
+        using FrameJLed =
+            TJLed<ArduinoAnalogWriter, JLedDynamicEffect, JLedFrameClock>;
+        FrameJLed leds[] = {FrameJLed(kTestPin).Blink(100, 100),
+                            FrameJLed(kTestPin + 1).Blink(100, 100)};
+        arduinoMockSetMillis(0);
+        JLedFrameClock::Tick();
+        REQUIRE(UpdateAll(leds, 2));
+        REQUIRE(arduinoMockGetPinState(kTestPin) == 255);
+        arduinoMockSetMillis(150);
+        REQUIRE(UpdateAll(leds, 2));
+        REQUIRE(arduinoMockGetPinState(kTestPin) == 255);
+        JLedFrameClock::Tick();
+        REQUIRE(UpdateAll(leds, 2));
+        REQUIRE(arduinoMockGetPinState(kTestPin) == 0);
+        REQUIRE(arduinoMockGetPinState(kTestPin + 1) == 0);
+    }
+
+    SECTION("RTC clock reads the user provided function") {
+        auto led = TJLed<ArduinoAnalogWriter, JLedDynamicEffect,
+                         JLedRtcClock<&rtcMillis>>(kTestPin)
+                       .On()
+                       .DelayBefore(1000);
+        rtc_now = 5000;
+        REQUIRE(led.Update());
+        REQUIRE(led.NextUpdateTime() == 6000);
+        rtc_now = 6000;
+        REQUIRE(led.Update());
+        REQUIRE(arduinoMockGetPinState(kTestPin) == 255);
+    }
+
+    SECTION("stepped clock simulates an hour of breathing") {
+        auto led = TJLed<ArduinoAnalogWriter, JLedDynamicEffect,
+                         JLedSteppedClock>(kTestPin)
+                       .Breathe(2000)
+                       .Repeat(1800);
+        JLedSteppedClock::Set(0);
+        uint32_t updates = 0;
+        while (led.Update()) {
+            JLedSteppedClock::Set(led.NextUpdateTime());
+            updates++;
+        }
+        REQUIRE(JLedSteppedClock::Now() == 3600000);
+        // only the ticks changing the output are simulated
+        REQUIRE(updates < 3600000 / 3);
+        REQUIRE(arduinoMockGetPinState(kTestPin) == 0);
+    }
+}
+
+TEST_CASE("Curve() interpolates user provided table", "[jled]") {
+    class TestableJLed : public JLed {
+     public:
+        static void test() {
+            SECTION("values at sample points and in between") {
+                // 5 values, i.e. samples at 0, 25, 50, 75 and t=99
+                constexpr auto kPeriod = 100;
+                const uintptr_t param =
+                    reinterpret_cast<uintptr_t>(&kTestCurve);
+                const std::map<uint32_t, uint8_t> test_values = {
+                    {0, 0},    {25, 200}, {50, 50}, {75, 255},
+                    {99, 10},  {200, 10}, {13, 103}, {62, 146},
+                    {87, 140}};
+                for (auto& x : test_values) {
+                    REQUIRE((int)x.second ==
+                            (int)JLed::CurveFunc(x.first, kPeriod, param));
+                }
+            }
+
+            SECTION("same as FadeOnFunc when using the fade on table") {
+                static const uint8_t kTable[] JLED_PROGMEM = {
+                    0, 3, 13, 33, 68, 118, 179, 232, 255};
+                static const JLedCurve kCurve = {kTable, sizeof(kTable)};
+                const uintptr_t param = reinterpret_cast<uintptr_t>(&kCurve);
+                for (uint32_t t = 0; t < 2000; t++) {
+                    REQUIRE(JLed::CurveFunc(t, 2000, param) ==
+                            JLed::FadeOnFunc(t, 2000, 0));
+                }
+            }
+        }
+    };
+    TestableJLed::test();
+}
+
+TEST_CASE("Curve() effect is output", "[jled]") {
+    constexpr auto kTestPin = 10;
+    arduinoMockInit();
+    JLed jled = JLed(kTestPin).Curve(kTestCurve, 100);
+    REQUIRE(jled.Update(0));
+    REQUIRE(arduinoMockGetPinState(kTestPin) == 0);
+    REQUIRE(jled.Update(25));
+    REQUIRE(arduinoMockGetPinState(kTestPin) == 200);
+    REQUIRE_FALSE(jled.Update(100));
+    REQUIRE(arduinoMockGetPinState(kTestPin) == 10);
+}
+
+TEST_CASE("JLedFadeOnTable generates fade on curve at compile time", "[jled]") {
+    SECTION("9 point table matches original pre-calculated table") {
+        const std::vector<uint8_t> expected = {0,   3,   13,  33, 68,
+                                               118, 179, 232, 255};
+        using Table = JLedFadeOnTable<9>;
+        static_assert(Table::Value(4) == 68, "table generated at compile time");
+        static_assert(Table::kSize == 9, "size");
+        REQUIRE(Table::Curve().size == 9);
+        for (auto i = 0; i < 9; i++) {
+            REQUIRE(JLedReadTable(Table::Table(), i) == expected[i]);
+        }
+    }
+
+    SECTION("constexpr math is precise") {
+        for (auto x = 0.; x <= 1.; x += 1. / 64) {
+            const auto ref = (exp(sin((x - .5) * PI)) - 0.36787944) * 108.;
+            REQUIRE(JLedFadeOnTable<9>::Eval(x) == Approx(ref).epsilon(1e-9));
+        }
+    }
+
+    SECTION("maximum error against floating point reference per size") {
+        // evaluate the interpolated curve at all 256 points in time an
+        // effect can distinguish (t scaled to 0..255).
+        auto max_error = [](const JLedCurve& curve) {
+            class TestableJLed : public JLed {
+             public:
+                static uint8_t Interpolate(const JLedCurve& curve, uint8_t s) {
+                    return JLed::Interpolate(curve.table, curve.size, s);
+                }
+            };
+            auto err = 0.;
+            for (auto s = 0; s < 256; s++) {
+                const auto ref = JLedFadeOnTable<257>::Eval(s / 256.);
+                const auto val = TestableJLed::Interpolate(curve, s);
+                err = max(err, std::abs(ref - val));
+            }
+            return err;
+        };
+        const std::vector<std::pair<int, double>> errors = {
+            {9, max_error(JLedFadeOnTable<9>::Curve())},
+            {17, max_error(JLedFadeOnTable<17>::Curve())},
+            {33, max_error(JLedFadeOnTable<33>::Curve())},
+            {65, max_error(JLedFadeOnTable<65>::Curve())},
+            {129, max_error(JLedFadeOnTable<129>::Curve())},
+            {257, max_error(JLedFadeOnTable<257>::Curve())}};
+        // upper bounds as documented in the README.
+        const double bounds[] = {5.6, 1.8, 1.5, 1.3, 1.0, 0.5};
+        for (const auto& e : errors) {
+            WARN("JLedFadeOnTable<" << e.first
+                                    << ">: max. error=" << e.second);
+        }
+        // rounding alone causes an error of up to 0.5 (truncation of the 9
+        // point table up to 1), the rest is caused by the interpolation.
+        for (auto i = 0u; i < errors.size(); i++) {
+            REQUIRE(errors[i].second < bounds[i]);
+            if (i > 0) REQUIRE(errors[i].second <= errors[i - 1].second);
+        }
+    }
+}
+
+TEST_CASE("257 point table needs no interpolation", "[jled]") {
+    class TestableJLed : public JLed {
+     public:
+        static void test() {
+            const auto& curve = JLedFadeOnTable<257>::Curve();
+            for (auto s = 0; s < 256; s++) {
+                REQUIRE(JLed::Interpolate(curve.table, curve.size, s) ==
+                        JLedFadeOnTable<257>::Value(s));
+            }
+        }
+    };
+    TestableJLed::test();
+}
+
+// writer recording the values of a 16 bit brightness pipeline
+class Recording16Writer {
+ public:
+    explicit Recording16Writer(std::vector<uint16_t>* values)
+        : values_(values) {}
+    void analogWrite(uint8_t) { FAIL("8 bit write not expected"); }
+    void analogWrite16(uint16_t val) { values_->push_back(val); }
+
+ private:
+    std::vector<uint16_t>* values_;
+};
+using TestJLed16 = TJLed<Recording16Writer, JLedDynamicEffectT<uint16_t>>;
+
+TEST_CASE("16 bit effects follow the 8 bit effects with higher resolution",
+          "[jled]") {
+    using Effects16 = JLedEffectsT<uint16_t>;
+    constexpr uint16_t kPeriod = 4000;
+    const struct {
+        JLedEffects::Brightness (*f8)(uint32_t, uint16_t, uintptr_t);
+        Effects16::Brightness (*f16)(uint32_t, uint16_t, uintptr_t);
+        uintptr_t param;
+    } effects[] = {
+        {&JLedEffects::OnFunc, &Effects16::OnFunc, 0},
+        {&JLedEffects::OffFunc, &Effects16::OffFunc, 0},
+        {&JLedEffects::BlinkFunc, &Effects16::BlinkFunc, 1000},
+        {&JLedEffects::FadeOnFunc, &Effects16::FadeOnFunc, 0},
+        {&JLedEffects::FadeOffFunc, &Effects16::FadeOffFunc, 0},
+        {&JLedEffects::BreatheFunc, &Effects16::BreatheFunc, 0},
+        {&JLedEffects::CurveFunc, &Effects16::CurveFunc,
+         reinterpret_cast<uintptr_t>(&kTestCurve)},
+    };
+    for (const auto& e : effects) {
+        for (uint32_t t = 0; t < kPeriod; t++) {
+            const auto val8 = e.f8(t, kPeriod, e.param);
+            const auto val16 = e.f16(t, kPeriod, e.param);
+            // the 8 bit version truncates the interpolated values and has a
+            // coarser resolution of the scaled time, which matters most for
+            // the steep segments of the test curve (up to 3.2 per step).
+            REQUIRE(std::abs(val16 / 257. - val8) < 4.);
+        }
+        REQUIRE(e.f16(kPeriod - 1, kPeriod, e.param) ==
+                e.f8(kPeriod - 1, kPeriod, e.param) * 257);
+    }
+
+    // a slow fade has many more steps than the 8 bit version
+    std::set<uint16_t> values8, values16;
+    for (uint32_t t = 0; t < kPeriod; t++) {
+        values8.insert(JLedEffects::FadeOnFunc(t, kPeriod, 0));
+        values16.insert(Effects16::FadeOnFunc(t, kPeriod, 0));
+        if (t > 0) {
+            REQUIRE(Effects16::FadeOnFunc(t, kPeriod, 0) >=
+                    Effects16::FadeOnFunc(t - 1, kPeriod, 0));
+        }
+    }
+    REQUIRE(values8.size() <= 256);
+    REQUIRE(values16.size() > 2000);
+}
+
+TEST_CASE("16 bit lightness table follows 8 bit table", "[jled]") {
+    REQUIRE(JLedLightnessTable::Lookup16(0) == 0);
+    REQUIRE(JLedLightnessTable::Lookup16(65535) == 65535);
+    for (uint32_t v = 1; v < 65536; v++) {
+        REQUIRE(JLedLightnessTable::Lookup16(v) >=
+                JLedLightnessTable::Lookup16(v - 1));
+    }
+    for (auto v = 0; v < 256; v++) {
+        const auto val16 = JLedLightnessTable::Lookup16(v * 257) / 257.;
+        REQUIRE(std::abs(val16 - JLedLightnessTable::Lookup(v)) <= 1.);
+    }
+    // the low end, where the 8 bit table has only few steps
+    std::set<uint16_t> values8, values16;
+    for (auto v = 0; v < 64; v++) {
+        values8.insert(JLedLightnessTable::Lookup(v));
+    }
+    for (auto v = 0; v < 64 * 257; v++) {
+        values16.insert(JLedLightnessTable::Lookup16(v));
+    }
+    REQUIRE(values8.size() < 16);
+    REQUIRE(values16.size() > 1000);
+}
+
+TEST_CASE("16 bit values flow to the writer", "[jled]") {
+    std::vector<uint16_t> values;
+    auto led = TestJLed16(Recording16Writer(&values));
+
+    SECTION("fade on") {
+        led.FadeOn(1000);
+        for (uint32_t t = 0; t < 1000; t++) led.Update(t);
+        REQUIRE(values.front() == 0);
+        REQUIRE(values.back() == 65535);
+        // every update changes the 16 bit value of a 1s fade
+        REQUIRE(values.size() > 900);
+        REQUIRE(led.NextUpdateTime() == 999 + 1);
+    }
+
+    SECTION("Invert(), LowActive() and Perceptual() use 16 bit range") {
+        led.UserFunc([](uint32_t, uint16_t, uintptr_t) -> uint16_t {
+               return 1000;
+           }, 1).Invert();
+        led.Update(0);
+        REQUIRE(values.back() == 65535 - 1000);
+
+        led.UserFunc([](uint32_t, uint16_t, uintptr_t) -> uint16_t {
+               return 1000;
+           }, 1).LowActive().Perceptual();
+        led.Update(1);
+        REQUIRE(values.back() ==
+                65535 - JLedLightnessTable::Lookup16(65535 - 1000));
+    }
+}
+
+static uint16_t ConstantFunc16(uint32_t, uint16_t, uintptr_t param) {
+    return param;
+}
+
+TEST_CASE("Dither() outputs 12 bit average with 8 bit writer", "[jled]") {
+    constexpr auto kTestPin = 10;
+    arduinoMockInit();
+    // returns the sum of the 8 bit outputs of the next 16 ticks
+    uint32_t now = 0;
+    auto sum16 = [&now](JLed16& led) {
+        uint32_t sum = 0;
+        for (auto i = 0; i < 16; i++) {
+            led.Update(now++);
+            sum += arduinoMockGetPinState(kTestPin);
+        }
+        return sum;
+    };
+
+    SECTION("average has 12 bits resolution") {
+        for (uint32_t v = 0; v < 0xff00; v += 37) {
+            JLed16 led =
+                JLed16(kTestPin).UserFunc(ConstantFunc16, 1, v).Forever();
+            REQUIRE(led.Dither().IsDithered());
+            REQUIRE(sum16(led) == v >> 4);
+            REQUIRE(sum16(led) == v >> 4);
+        }
+    }
+
+    SECTION("without dithering, the value is truncated") {
+        JLed16 led = JLed16(kTestPin).UserFunc(ConstantFunc16, 1, 0x180);
+        REQUIRE_FALSE(led.IsDithered());
+        REQUIRE(sum16(led) == 16);
+    }
+
+    SECTION("full brightness is not exceeded") {
+        JLed16 led = JLed16(kTestPin)
+                         .UserFunc(ConstantFunc16, 1, 65535)
+                         .Forever()
+                         .Dither();
+        REQUIRE(sum16(led) == 16 * 255);
+    }
+
+    SECTION("only changes of the 8 bit output are written") {
+        JLed16 led =
+            JLed16(kTestPin).UserFunc(ConstantFunc16, 1, 0x1000).Forever();
+        led.Dither();
+        sum16(led);
+        REQUIRE(arduinoMockGetAnalogWriteCount(kTestPin) == 1);
+        led.UserFunc(ConstantFunc16, 1, 0x1080).Forever();
+        sum16(led);
+        REQUIRE(arduinoMockGetAnalogWriteCount(kTestPin) == 1 + 16);
+    }
+
+    SECTION("dithering continues in delay after phase") {
+        JLed16 led = JLed16(kTestPin)
+                         .UserFunc(ConstantFunc16, 10, 0x1c0)
+                         .DelayAfter(100)
+                         .Forever()
+                         .Dither();
+        sum16(led);  // 10ms period and first 6 ms of delay after
+        REQUIRE(led.NextUpdateTime() == now);
+        REQUIRE(sum16(led) == 0x1c);
+    }
+
+    SECTION("final value is rounded to the nearest 8 bit value") {
+        JLed16 led = JLed16(kTestPin).UserFunc(ConstantFunc16, 10, 0x1c0);
+        led.Dither();
+        sum16(led);
+        REQUIRE_FALSE(led.Update(now));
+        REQUIRE(arduinoMockGetPinState(kTestPin) == 2);
+
+        led = JLed16(kTestPin).UserFunc(ConstantFunc16, 10, 0x140).Dither();
+        sum16(led);
+        REQUIRE(arduinoMockGetPinState(kTestPin) == 1);
+    }
+
+    SECTION("LowActive() is applied before dithering") {
+        JLed16 led = JLed16(kTestPin)
+                         .UserFunc(ConstantFunc16, 1, 0x180)
+                         .LowActive()
+                         .Forever()
+                         .Dither();
+        REQUIRE(sum16(led) == (65535 - 0x180) >> 4);
+    }
+}
+
+// writer with hardware fade support, recording fades and writes
+class FadingWriter {
+ public:
+    struct Fade {
+        uint16_t val;
+        uint32_t duration;
+    };
+    struct Recording {
+        std::vector<Fade> fades;
+        std::vector<uint8_t> writes;
+        std::vector<size_t> writes_before;  // number of fades before write
+    };
+    explicit FadingWriter(Recording* rec) : rec_(rec) {}
+    void analogWrite(uint8_t val) {
+        rec_->writes.push_back(val);
+        rec_->writes_before.push_back(rec_->fades.size());
+    }
+    void analogFade16(uint16_t val, uint32_t duration) {
+        rec_->fades.push_back({val, duration});
+    }
+
+ private:
+    Recording* rec_;
+};
+
+TEST_CASE("HardwareFade() programs one fade per linear segment", "[jled]") {
+    using FadingJLed = TJLed<FadingWriter>;
+    constexpr auto kSegments =
+        JLedFadeOnTable<JLED_FADE_ON_TABLE_SIZE>::kSize - 1;
+    constexpr uint16_t kPeriod = 100 * kSegments;
+    FadingWriter::Recording rec;
+    const auto& fades = rec.fades;
+
+    SECTION("FadeOn() updated on every tick") {
+        auto led = FadingJLed(FadingWriter(&rec)).FadeOn(kPeriod);
+        REQUIRE(led.HardwareFade().IsHardwareFade());
+        uint32_t t = 0;
+        while (led.Update(t)) t++;
+        REQUIRE(fades.size() == kSegments);
+        for (auto i = 0; i < kSegments; i++) {
+            const uint32_t end = min((i + 1) * 100, kPeriod - 1);
+            REQUIRE(fades[i].duration == end - i * 100);
+            REQUIRE(fades[i].val ==
+                    257 * JLedEffects::FadeOnFunc(end, kPeriod, 0));
+        }
+        REQUIRE(fades.back().val == 0xffff);
+        // only the start value is written, the final value was already
+        // reached by the last fade
+        REQUIRE(rec.writes == std::vector<uint8_t>{0});
+        REQUIRE(rec.writes_before == std::vector<size_t>{0});
+    }
+
+    SECTION("NextUpdateTime() returns end of segment") {
+        auto led =
+            FadingJLed(FadingWriter(&rec)).Breathe(2 * kPeriod).HardwareFade();
+        uint32_t t = 0;
+        while (led.Update(t)) t = led.NextUpdateTime();
+        REQUIRE(fades.size() == 2 * kSegments);
+        for (auto i = 0; i < kSegments; i++) {
+            REQUIRE(fades[i].duration == 100);
+        }
+        REQUIRE(fades.back().val == 0);
+        REQUIRE(rec.writes == std::vector<uint8_t>{0});
+    }
+
+    SECTION("fade restarts with the next iteration") {
+        auto led = FadingJLed(FadingWriter(&rec))
+                       .FadeOff(kPeriod)
+                       .LowActive()
+                       .Repeat(2)
+                       .HardwareFade();
+        uint32_t t = 0;
+        while (led.Update(t)) t++;
+        REQUIRE(fades.size() == 2 * kSegments);
+        // LowActive() applies to the target values
+        REQUIRE(fades[kSegments - 1].val == 0xffff);
+        REQUIRE(fades[kSegments].val ==
+                0xffff - 257 * JLedEffects::FadeOffFunc(100, kPeriod, 0));
+        // each iteration starts at its (low active) start value
+        REQUIRE(rec.writes == std::vector<uint8_t>{0, 0});
+        REQUIRE(rec.writes_before == std::vector<size_t>{0, kSegments});
+    }
+
+    SECTION("fades start at the start value of the effect") {
+        auto fade_off =
+            FadingJLed(FadingWriter(&rec)).FadeOff(kPeriod).HardwareFade();
+        REQUIRE(fade_off.Update(0));
+        REQUIRE(rec.writes == std::vector<uint8_t>{255});
+        REQUIRE(fades.size() == 1);
+        REQUIRE(fades[0].val < 0xffff);
+
+        FadingWriter::Recording rec2;
+        auto fade_on = FadingJLed(FadingWriter(&rec2))
+                           .FadeOn(kPeriod)
+                           .DelayAfter(50)
+                           .Repeat(2)
+                           .HardwareFade();
+        uint32_t t = 0;
+        while (fade_on.Update(t)) t++;
+        REQUIRE(rec2.fades.size() == 2 * kSegments);
+        // the second iteration restarts at 0 after the delay after phase
+        REQUIRE(rec2.writes == std::vector<uint8_t>{0, 0});
+        REQUIRE(rec2.writes_before == std::vector<size_t>{0, kSegments});
+    }
+
+    SECTION("other effects and Perceptual() are written in software") {
+        auto blink =
+            FadingJLed(FadingWriter(&rec)).Blink(10, 10).HardwareFade();
+        auto fade = FadingJLed(FadingWriter(&rec))
+                        .FadeOn(kPeriod)
+                        .Perceptual()
+                        .HardwareFade();
+        for (uint32_t t = 0; t < 20; t++) {
+            blink.Update(t);
+            fade.Update(t);
+        }
+        REQUIRE(fades.empty());
+        REQUIRE(rec.writes.size() > 2);
+    }
+
+    SECTION("segments of long effects are not truncated to 16 bits") {
+        auto led = TJLed<FadingWriter, JLedDynamicEffect, JLedLongMillisClock>(
+                       FadingWriter(&rec))
+                       .FadeOn(600000)
+                       .HardwareFade();
+        REQUIRE(led.Update(0));
+        REQUIRE(fades.size() == 1);
+        REQUIRE(fades[0].duration > 65535);
+        REQUIRE(fades[0].duration == led.NextUpdateTime());
+    }
+
+    SECTION("writers without hardware fade ignore HardwareFade()") {
+        constexpr auto kTestPin = 10;
+        arduinoMockInit();
+        auto led = JLed(kTestPin).FadeOn(kPeriod).HardwareFade();
+        for (uint32_t t = 0; t < kPeriod; t++) led.Update(t);
+        REQUIRE(arduinoMockGetAnalogWriteCount(kTestPin) > kSegments);
+    }
+}
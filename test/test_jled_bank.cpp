@@ -0,0 +1,180 @@
+// JLedBank unit tests (run on host).
+// Copyright 2017 Jan Delgado jdelgado@gmx.net
+#include <vector>
+#include "catch.hpp"
+
+#include <jled.h>  // NOLINT
+
+TEST_CASE("bank ctor sets pin mode of all LEDs to OUTPUT", "[jled_bank]") {
+    arduinoMockInit();
+    JLedBank<3, ArduinoAnalogWriter> bank(1, 2, 3);
+    REQUIRE(bank.size() == 3);
+    for (auto pin = 1; pin <= 3; pin++) {
+        REQUIRE(arduinoMockGetPinMode(pin) == OUTPUT);
+    }
+    // no effects configured yet
+    REQUIRE_FALSE(bank.IsActive());
+    REQUIRE_FALSE(bank.Update(0));
+}
+
+TEST_CASE("bank LEDs behave like individual JLed objects", "[jled_bank]") {
+    arduinoMockInit();
+    // pins 1..5 are driven by the bank, pins 11..15 by JLed objects.
+    JLedBank<5, ArduinoAnalogWriter> bank(1, 2, 3, 4, 5);
+    bank[0].Breathe(200).DelayAfter(50).Repeat(3).Perceptual();
+    bank[1].Blink(20, 30).DelayBefore(15).Forever();
+    bank[2].FadeOn(100).Invert();
+    bank[3].FadeOff(300).LowActive().Perceptual().Repeat(2);
+    bank[4].On().DelayBefore(500);
+
+    JLed leds[] = {JLed(11).Breathe(200).DelayAfter(50).Repeat(3).Perceptual(),
+                   JLed(12).Blink(20, 30).DelayBefore(15).Forever(),
+                   JLed(13).FadeOn(100).Invert(),
+                   JLed(14).FadeOff(300).LowActive().Perceptual().Repeat(2),
+                   JLed(15).On().DelayBefore(500)};
+    REQUIRE(bank[1].IsForever());
+    REQUIRE(bank[2].IsInverted());
+    REQUIRE(bank[3].IsLowActive());
+    REQUIRE(bank[3].IsPerceptual());
+
+    for (uint32_t now = 1000; now < 2000; now += (now % 7 == 0) ? 3 : 1) {
+        REQUIRE(bank.Update(now) == UpdateAll(leds, 5, now));
+        for (auto i = 0; i < 5; i++) {
+            REQUIRE(arduinoMockGetPinState(1 + i) ==
+                    arduinoMockGetPinState(11 + i));
+            REQUIRE(arduinoMockGetAnalogWriteCount(1 + i) ==
+                    arduinoMockGetAnalogWriteCount(11 + i));
+        }
+    }
+}
+
+TEST_CASE("bank LED configured later starts on next update", "[jled_bank]") {
+    arduinoMockInit();
+    JLedBank<2, ArduinoAnalogWriter> bank(1, 2);
+    bank[0].Blink(10, 10).Forever();
+    REQUIRE(bank.Update(0));
+    REQUIRE(bank.Update(10));
+    REQUIRE(arduinoMockGetPinState(1) == 0);
+
+    // second LED starts at time 15
+    bank[1].Blink(5, 5);
+    REQUIRE(bank.Update(15));
+    REQUIRE(arduinoMockGetPinState(1) == 0);
+    REQUIRE(arduinoMockGetPinState(2) == 255);
+    REQUIRE(bank.Update(20));
+    REQUIRE(arduinoMockGetPinState(1) == 255);
+    REQUIRE(arduinoMockGetPinState(2) == 0);
+    REQUIRE(bank[1].IsActive());
+    REQUIRE(bank.Update(25));
+    REQUIRE_FALSE(bank[1].IsActive());
+    REQUIRE(bank[0].IsActive());
+
+    bank[0].Stop();
+    REQUIRE(arduinoMockGetPinState(1) == 0);
+    REQUIRE_FALSE(bank.Update(30));
+}
+
+TEST_CASE("bank starts LEDs at any time stamp", "[jled_bank]") {
+    arduinoMockInit();
+    JLedBank<2, ArduinoAnalogWriter> bank(1, 2);
+
+    SECTION("first update at UINT32_MAX") {
+        bank[0].On();
+        REQUIRE(bank.Update(UINT32_MAX));
+        REQUIRE(arduinoMockGetPinState(1) == 255);
+        REQUIRE(arduinoMockGetAnalogWriteCount(1) == 1);
+    }
+
+    SECTION("LED configured within the current tick") {
+        bank[0].Blink(10, 10).Forever();
+        REQUIRE(bank.Update(100));
+        bank[1].On();
+        REQUIRE(bank.Update(100));
+        REQUIRE(arduinoMockGetPinState(2) == 255);
+        // the other LED is not written again
+        REQUIRE(arduinoMockGetAnalogWriteCount(1) == 1);
+    }
+}
+
+TEST_CASE("bank with user function and static effect", "[jled_bank]") {
+    arduinoMockInit();
+    auto func = [](uint32_t t, uint16_t, uintptr_t param) -> uint8_t {
+        return t * param;
+    };
+    JLedBank<2, ArduinoAnalogWriter> bank(1, 2);
+    bank[0].UserFunc(func, 10, 2);
+    bank[1].UserFunc<&JLedEffects::OnFunc>(1);
+    bank.Update(0);
+    bank.Update(3);
+    REQUIRE(arduinoMockGetPinState(1) == 6);
+    REQUIRE(arduinoMockGetPinState(2) == 255);
+
+    static const uint8_t kTable[] JLED_PROGMEM = {100, 200};
+    static const JLedCurve kCurve = {kTable, sizeof(kTable)};
+    bank[0].Curve(kCurve, 10);
+    bank.Update(4);
+    REQUIRE(arduinoMockGetPinState(1) == 100);
+    bank.Update(9);  // t=5, halfway
+    REQUIRE(arduinoMockGetPinState(1) == 150);
+    bank.Update(13);  // t=9, end of period
+    REQUIRE(arduinoMockGetPinState(1) == 200);
+
+    JLedBank<1, ArduinoAnalogWriter, JLedStaticEffect<&JLedEffects::BlinkFunc>>
+        static_bank(3);
+    static_bank[0].Blink(1, 1);
+    REQUIRE(static_bank.Update(0));
+    REQUIRE(arduinoMockGetPinState(3) == 255);
+    REQUIRE(static_bank.Update(1));
+    REQUIRE(arduinoMockGetPinState(3) == 0);
+    REQUIRE_FALSE(static_bank.Update(2));
+}
+
+TEST_CASE("bank reads the time from its clock policy", "[jled_bank]") {
+    arduinoMockInit();
+    JLedBank<2, ArduinoAnalogWriter, JLedDynamicEffect, JLedSteppedClock> bank(
+        1, 2);
+    bank[0].Blink(10, 10);
+    bank[1].On().DelayBefore(15);
+    JLedSteppedClock::Set(100);
+    REQUIRE(bank.Update());
+    REQUIRE(arduinoMockGetPinState(1) == 255);
+    REQUIRE(arduinoMockGetPinState(2) == 0);
+    JLedSteppedClock::Step(15);
+    REQUIRE(bank.Update());
+    REQUIRE(arduinoMockGetPinState(1) == 0);
+    REQUIRE(arduinoMockGetPinState(2) == 255);
+}
+
+TEST_CASE("bank is not affected by the wrap around of millis()",
+          "[jled_bank]") {
+    arduinoMockInit();
+    JLedBank<1, ArduinoAnalogWriter> bank(1);
+    JLed ref(2);
+    bank[0].Blink(100, 100).DelayAfter(50).DelayBefore(20).Forever();
+    ref.Blink(100, 100).DelayAfter(50).DelayBefore(20).Forever();
+    const uint32_t start = UINT32_MAX - 130;
+    for (uint32_t t = 0; t < 1000; t++) {
+        bank.Update(start + t);
+        ref.Update(t);
+        REQUIRE(arduinoMockGetPinState(1) == arduinoMockGetPinState(2));
+    }
+}
+
+TEST_CASE("bank handles updates skipping iterations like JLed",
+          "[jled_bank]") {
+    arduinoMockInit();
+    JLedBank<2, ArduinoAnalogWriter> bank(1, 2);
+    bank[0].Blink(1, 2).DelayAfter(2).Forever();
+    bank[1].Blink(1, 1).Repeat(60000);
+    JLed leds[] = {JLed(11).Blink(1, 2).DelayAfter(2).Forever(),
+                   JLed(12).Blink(1, 1).Repeat(60000)};
+    // the last update skips 2^32-1 ms, i.e. billions of iterations
+    for (const uint32_t now : {0u, 1u, 5u, 11u, 1000u, 1003u, 3u, 2u}) {
+        REQUIRE(bank.Update(now) == UpdateAll(leds, 2, now));
+        for (auto i = 0; i < 2; i++) {
+            REQUIRE(arduinoMockGetPinState(1 + i) ==
+                    arduinoMockGetPinState(11 + i));
+        }
+    }
+    REQUIRE_FALSE(bank[1].IsActive());
+}
@@ -9,8 +9,11 @@ TEST_CASE("arduino mock correctly initialized", "[mock]") {
     for (auto i = 0; i < ARDUINO_PINS; i++) {
         REQUIRE(arduinoMockGetPinMode(i) == 0);
         REQUIRE(arduinoMockGetPinState(i) == 0);
+        REQUIRE(arduinoMockGetAnalogWriteCount(i) == 0);
         REQUIRE(arduinoMockGetLedcAttachPin(i) == 0);
         REQUIRE(arduinoMockGetLedcAttachPin(i) == 0);
+        REQUIRE_FALSE(arduinoMockGetPortPinState(i));
+        REQUIRE(arduinoMockGetPinHighTicks(i) == 0);
     }
     for (auto i = 0; i < LEDC_CHANNELS; i++) {
         REQUIRE(arduinoMockGetLedcState(i) == 0);
@@ -33,4 +36,44 @@ TEST_CASE("arduino mock analog write", "[mock]") {
     arduinoMockInit();
     analogWrite(kTestPin, 99);
     REQUIRE(arduinoMockGetPinState(kTestPin) == 99);
+    REQUIRE(arduinoMockGetAnalogWriteCount(kTestPin) == 1);
+}
+
+TEST_CASE("arduino mock port registers", "[mock]") {
+    arduinoMockInit();
+    REQUIRE(digitalPinToPort(3) == 1);
+    REQUIRE(digitalPinToPort(10) == 2);
+    REQUIRE(digitalPinToBitMask(10) == 4);
+    *portOutputRegister(digitalPinToPort(10)) |= digitalPinToBitMask(10);
+    REQUIRE(arduinoMockGetPortPinState(10));
+    REQUIRE_FALSE(arduinoMockGetPortPinState(11));
+    REQUIRE_FALSE(arduinoMockGetPortPinState(2));
+}
+
+TEST_CASE("arduino mock timer simulation", "[mock]") {
+    arduinoMockInit();
+    // toggles pin 1 and fires again after 1 tick when pin is on, after 3 ticks
+    // when off
+    const auto stats = arduinoMockRunTimer(
+        []() -> uint8_t {
+            *portOutputRegister(1) ^= 2;
+            return (*portOutputRegister(1) & 2) ? 1 : 3;
+        },
+        40);
+    REQUIRE(stats.isr_calls == 20);
+    REQUIRE(stats.ns_per_isr_call > 0.);
+    REQUIRE(arduinoMockGetPinHighTicks(1) == 10);
+    REQUIRE(arduinoMockGetPinHighTicks(0) == 0);
+}
+
+TEST_CASE("arduino mock digitalWrite() counts rising edges", "[mock]") {
+    constexpr auto kPin = 7;
+    arduinoMockInit();
+    digitalWrite(kPin, HIGH);
+    digitalWrite(kPin, HIGH);
+    digitalWrite(kPin, LOW);
+    digitalWrite(kPin, HIGH);
+    REQUIRE(arduinoMockGetPinState(kPin) == HIGH);
+    REQUIRE(arduinoMockGetDigitalWriteCount(kPin) == 4);
+    REQUIRE(arduinoMockGetRisingEdgeCount(kPin) == 2);
 }
@@ -0,0 +1,132 @@
+// JLed Unit tests  (run on host).
+// Copyright 2017 Jan Delgado jdelgado@gmx.net
+#define CATCH_CONFIG_MAIN
+#include "catch.hpp"
+#include <jled.h>            // NOLINT
+#include <pca9685_writer.h>  // NOLINT
+
+using Pca9685JLed = TJLed<Pca9685Writer<>>;
+
+// registers LEDn_ON_L..LEDn_OFF_H sent for channel i of transmission t, which
+// starts with channel first.
+static uint32_t ChannelRegisters(int t, int first, int i) {
+    uint32_t regs = 0;
+    for (auto k = 0; k < 4; k++) {
+        regs |= uint32_t{wireMockGetTransmissionByte(t, 1 + 4 * (i - first) +
+                                                      k)}
+                << (8 * k);
+    }
+    return regs;
+}
+
+TEST_CASE("Begin() enables auto increment", "[pca9685_writer]") {
+    wireMockInit();
+    arduinoMockInit();
+    JLedPca9685 pca(0x41);
+    pca.Begin();
+
+    // oscillator startup time after clearing SLEEP
+    REQUIRE(micros() >= 500);
+
+    REQUIRE(wireMockIsInitialized());
+    REQUIRE(wireMockGetTransmissionCount() == 2);
+    REQUIRE(wireMockGetAddress(0) == 0x41);
+    REQUIRE(wireMockGetTransmissionSize(0) == 2);
+    REQUIRE(wireMockGetTransmissionByte(0, 0) == 0x00);  // MODE1
+    REQUIRE(wireMockGetTransmissionByte(0, 1) == 0x21);  // AI | ALLCALL
+    REQUIRE(wireMockGetTransmissionByte(1, 0) == 0x01);  // MODE2
+    REQUIRE(wireMockGetTransmissionByte(1, 1) == 0x04);  // OUTDRV
+}
+
+TEST_CASE("writer maps values to 12 bit channel registers",
+          "[pca9685_writer]") {
+    wireMockInit();
+    JLedPca9685 pca;
+    Pca9685Writer<>(pca, 2).analogWrite(0);
+    Pca9685Writer<>(pca, 3).analogWrite(255);
+    Pca9685Writer<>(pca, 4).analogWrite(128);
+    Pca9685Writer<>(pca, 5).analogWrite16(0x0010);
+    Pca9685Writer<>(pca, 6).analogWrite16(0x000f);  // 0 in 12 bits
+    pca.Stage(2, 1);                              // changed, but 0 in 12 bits
+    REQUIRE(pca.Commit());
+
+    REQUIRE(wireMockGetTransmissionCount() == 1);
+    REQUIRE(wireMockGetAddress(0) == 0x40);
+    REQUIRE(wireMockGetTransmissionSize(0) == 1 + 5 * 4);
+    REQUIRE(wireMockGetTransmissionByte(0, 0) == 0x06 + 2 * 4);  // LED2_ON_L
+    // OFF_H, OFF_L, ON_H, ON_L
+    REQUIRE(ChannelRegisters(0, 2, 2) == 0x10000000);  // full off
+    REQUIRE(ChannelRegisters(0, 2, 3) == 0x00001000);  // full on
+    REQUIRE(ChannelRegisters(0, 2, 4) == (uint32_t{128 * 257 >> 4} << 16));
+    REQUIRE(ChannelRegisters(0, 2, 5) == 0x00010000);
+    REQUIRE(ChannelRegisters(0, 2, 6) == 0x10000000);
+}
+
+TEST_CASE("refresh of all channels is a single I2C transmission",
+          "[pca9685_writer]") {
+    wireMockInit();
+    JLedPca9685 pca;
+    Pca9685JLed leds[] = {
+        Pca9685JLed(Pca9685Writer<>(pca, 0)).On(),
+        Pca9685JLed(Pca9685Writer<>(pca, 1)).On(),
+        Pca9685JLed(Pca9685Writer<>(pca, 2)).On(),
+        Pca9685JLed(Pca9685Writer<>(pca, 3)).On(),
+        Pca9685JLed(Pca9685Writer<>(pca, 4)).On(),
+        Pca9685JLed(Pca9685Writer<>(pca, 5)).On(),
+        Pca9685JLed(Pca9685Writer<>(pca, 6)).On(),
+        Pca9685JLed(Pca9685Writer<>(pca, 7)).On(),
+        Pca9685JLed(Pca9685Writer<>(pca, 8)).On(),
+        Pca9685JLed(Pca9685Writer<>(pca, 9)).On(),
+        Pca9685JLed(Pca9685Writer<>(pca, 10)).On(),
+        Pca9685JLed(Pca9685Writer<>(pca, 11)).On(),
+        Pca9685JLed(Pca9685Writer<>(pca, 12)).On(),
+        Pca9685JLed(Pca9685Writer<>(pca, 13)).On(),
+        Pca9685JLed(Pca9685Writer<>(pca, 14)).On(),
+        Pca9685JLed(Pca9685Writer<>(pca, 15)).On()};
+
+    UpdateAll(leds, 16, 0);
+    REQUIRE(wireMockGetTransmissionCount() == 0);
+    REQUIRE(pca.Commit());
+
+    REQUIRE(wireMockGetTransmissionCount() == 1);
+    REQUIRE(wireMockGetTransmissionSize(0) == 1 + 16 * 4);
+    REQUIRE(wireMockGetTransmissionByte(0, 0) == 0x06);
+    for (auto i = 0; i < 16; i++) {
+        REQUIRE(ChannelRegisters(0, 0, i) == 0x00001000);
+    }
+
+    // nothing changed
+    UpdateAll(leds, 16, 1);
+    REQUIRE_FALSE(pca.Commit());
+    REQUIRE(wireMockGetTransmissionCount() == 1);
+}
+
+TEST_CASE("bursts are split to fit into the Wire buffer", "[pca9685_writer]") {
+    wireMockInit();
+    JLedPca9685T<32> pca;  // AVR: 7 channels per transmission
+    static_assert(JLedPca9685Bus<32>::kMaxBurstChannels == 7, "");
+    for (auto i = 1; i < 16; i++) pca.Stage(i, 0xffff);
+    REQUIRE(pca.Commit());
+
+    REQUIRE(wireMockGetTransmissionCount() == 3);
+    REQUIRE(wireMockGetTransmissionSize(0) == 1 + 7 * 4);
+    REQUIRE(wireMockGetTransmissionByte(0, 0) == 0x06 + 1 * 4);
+    REQUIRE(wireMockGetTransmissionSize(1) == 1 + 7 * 4);
+    REQUIRE(wireMockGetTransmissionByte(1, 0) == 0x06 + 8 * 4);
+    REQUIRE(wireMockGetTransmissionSize(2) == 1 + 1 * 4);
+    REQUIRE(wireMockGetTransmissionByte(2, 0) == 0x06 + 15 * 4);
+    REQUIRE(ChannelRegisters(2, 15, 15) == 0x00001000);
+}
+
+TEST_CASE("writer works with a custom Wire buffer length",
+          "[pca9685_writer]") {
+    wireMockInit();
+    JLedPca9685T<32> pca;
+    auto led = TJLed<Pca9685Writer<32>>(Pca9685Writer<32>(pca, 15)).On();
+    led.Update(0);
+    REQUIRE(pca.Commit());
+
+    REQUIRE(wireMockGetTransmissionCount() == 1);
+    REQUIRE(wireMockGetTransmissionByte(0, 0) == 0x06 + 15 * 4);
+    REQUIRE(ChannelRegisters(0, 15, 15) == 0x00001000);
+}
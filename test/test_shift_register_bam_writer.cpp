@@ -0,0 +1,141 @@
+// JLed Unit tests  (run on host).
+// Copyright 2017 Jan Delgado jdelgado@gmx.net
+#define CATCH_CONFIG_MAIN
+#include "catch.hpp"
+#include <jled.h>                        // NOLINT
+#include <shift_register_bam_writer.h>  // NOLINT
+
+constexpr auto kLatchPin = 10;
+
+// simulates a chain of M 74HC595 shift registers connected to SPI, and
+// records for every output the number of time units it was on.
+template <uint8_t M>
+class ShiftRegisterSimulation {
+ public:
+    explicit ShiftRegisterSimulation(JLedShiftRegisterBam<M>* bam)
+        : bam_(bam) {}
+
+    // runs the ISR of the engine for the given number of time units.
+    void Run(uint32_t units) {
+        while (units > 0) {
+            // the ISR latches the bytes shifted out during the last call
+            const auto shifted = Shifted();
+            const auto transactions = spiMockGetTransactionCount();
+            const uint32_t duration = bam_->Isr();
+            // the latch is pulsed through the port register and left low
+            REQUIRE_FALSE(arduinoMockGetPortPinState(kLatchPin));
+            REQUIRE(spiMockGetTransactionCount() == transactions + 1);
+            REQUIRE_FALSE(spiMockInTransaction());
+            isr_calls_++;
+
+            const auto n = min(duration, units);
+            for (auto i = 0; i < 8 * M; i++) {
+                if (shifted[i >> 3] & (1 << (i & 7))) on_[i] += n;
+            }
+            units -= n;
+        }
+    }
+
+    uint32_t on(uint8_t chan) const { return on_[chan]; }
+    uint32_t isr_calls() const { return isr_calls_; }
+
+    // the register contents after the last SPI transaction. The byte shifted
+    // out first ends up in the last register.
+    std::vector<uint8_t> Shifted() const {
+        REQUIRE(spiMockGetTransactionSize() == M);
+        std::vector<uint8_t> regs(M);
+        for (auto i = 0; i < M; i++) {
+            regs[M - 1 - i] = spiMockGetTransactionByte(i);
+        }
+        return regs;
+    }
+
+ private:
+    JLedShiftRegisterBam<M>* bam_;
+    uint32_t on_[8 * M] = {};
+    uint32_t isr_calls_ = 0;
+};
+
+TEST_CASE("Begin() initializes SPI and latch pin", "[shift_register_bam]") {
+    arduinoMockInit();
+    spiMockInit();
+    JLedShiftRegisterBam<2> bam(kLatchPin, 4000000);
+    bam.Set(0, 1);
+    bam.Begin();
+
+    REQUIRE(arduinoMockGetPinMode(kLatchPin) == OUTPUT);
+    REQUIRE(arduinoMockGetPinState(kLatchPin) == LOW);
+    REQUIRE(spiMockIsInitialized());
+    REQUIRE(spiMockGetUsingInterrupt() == int{JLedBamTimer::kSpiInterrupt});
+    REQUIRE(spiMockGetSettings().clock == 4000000);
+    REQUIRE(spiMockGetSettings().bit_order == MSBFIRST);
+    // plane 0 shifted out, but not yet latched
+    REQUIRE(spiMockGetTransactionCount() == 1);
+    REQUIRE(ShiftRegisterSimulation<2>(&bam).Shifted() ==
+            std::vector<uint8_t>({1, 0}));
+    REQUIRE(arduinoMockGetRisingEdgeCount(kLatchPin) == 0);
+}
+
+TEST_CASE("BAM engine outputs brightness with 8 interrupts per period",
+          "[shift_register_bam]") {
+    arduinoMockInit();
+    spiMockInit();
+    JLedShiftRegisterBam<3> bam(kLatchPin);
+    ShiftRegisterSimulation<3> sim(&bam);
+    for (auto i = 0; i < bam.kNumChannels; i++) bam.Set(i, i * 11);
+    bam.Set(bam.kNumChannels, 255);  // ignored
+    bam.Begin();
+
+    constexpr auto kPeriods = 10;
+    sim.Run(kPeriods * 255);
+    REQUIRE(sim.isr_calls() == kPeriods * 8);
+    REQUIRE(spiMockGetTransactionCount() == 1 + kPeriods * 8);
+    for (auto i = 0; i < bam.kNumChannels; i++) {
+        REQUIRE(sim.on(i) == kPeriods * i * 11);
+    }
+}
+
+TEST_CASE("TJLed drives shift register output", "[shift_register_bam]") {
+    arduinoMockInit();
+    spiMockInit();
+    JLedShiftRegisterBam<2> bam(kLatchPin);
+    ShiftRegisterSimulation<2> sim(&bam);
+    using BamJLed = TJLed<ShiftRegisterBamWriter<2>>;
+    BamJLed leds[] = {
+        BamJLed(ShiftRegisterBamWriter<2>(bam, 3)).On(),
+        BamJLed(ShiftRegisterBamWriter<2>(bam, 12)).Off()};
+    ShiftRegisterBamWriter<2>(bam, 7).analogWrite(77);
+    bam.Begin();
+
+    // plane 0 was shifted out by Begin() before the update, so the update
+    // is output from the second period on.
+    UpdateAll(leds, 2, 0);
+    sim.Run(2 * 255);
+    REQUIRE(sim.on(3) == 255);
+    REQUIRE(sim.on(7) == 2 * 77);
+    REQUIRE(sim.on(12) == 0);
+    REQUIRE(sim.on(0) == 0);
+}
+
+TEST_CASE("changes are output from the next period on",
+          "[shift_register_bam]") {
+    arduinoMockInit();
+    spiMockInit();
+    JLedShiftRegisterBam<1> bam(kLatchPin);
+    bam.Set(0, 127);
+    bam.Begin();
+
+    // change 127 to 128 after phase 5 of a period, which must not output a
+    // mix of both values (e.g. 255) for the period.
+    ShiftRegisterSimulation<1> sim(&bam);
+    sim.Run(63);
+    bam.Set(0, 128);
+    sim.Run(192);
+    REQUIRE(sim.on(0) == 127);
+    sim.Run(63);
+    bam.Set(0, 127);
+    sim.Run(192);
+    REQUIRE(sim.on(0) == 127 + 128);
+    sim.Run(255);
+    REQUIRE(sim.on(0) == 127 + 128 + 127);
+}
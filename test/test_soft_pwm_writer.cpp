@@ -0,0 +1,151 @@
+// JLed Unit tests  (run on host).
+// Copyright 2017 Jan Delgado jdelgado@gmx.net
+#define CATCH_CONFIG_MAIN
+#include "catch.hpp"
+#include <jled.h>             // NOLINT
+#include <soft_pwm_writer.h>  // NOLINT
+
+// engine driven by the simulated timer, see arduinoMockRunTimer()
+static JLedSoftPwm* pwm_;
+static uint8_t Isr() { return pwm_->Isr(); }
+
+TEST_CASE("soft pwm attaches pins to channels", "[soft_pwm_writer]") {
+    arduinoMockInit();
+    JLedSoftPwm pwm;
+
+    REQUIRE(pwm.Attach(1) == 0);
+    REQUIRE(pwm.Attach(9) == 1);
+    REQUIRE(pwm.Attach(2) == 2);
+    REQUIRE(pwm.num_channels() == 3);
+    REQUIRE(pwm.num_ports() == 2);
+    REQUIRE(arduinoMockGetPinMode(1) == OUTPUT);
+    REQUIRE(arduinoMockGetPinMode(9) == OUTPUT);
+
+    // all ports in use (JLED_SOFT_PWM_MAX_PORTS)
+    REQUIRE(pwm.Attach(17) == 3);
+    REQUIRE(pwm.Attach(25) == int{JLedSoftPwm::kNoChannel});
+    REQUIRE(arduinoMockGetPinMode(25) == 0);
+
+    // all channels in use
+    for (auto i = 4; i < JLedSoftPwm::kMaxChannels; i++) {
+        REQUIRE(pwm.Attach(i) == i);
+    }
+    REQUIRE(pwm.Attach(20) == int{JLedSoftPwm::kNoChannel});
+
+    auto writer = SoftPwmWriter(pwm, 21);
+    REQUIRE(writer.chan() == int{JLedSoftPwm::kNoChannel});
+    writer.analogWrite(255);  // ignored
+}
+
+TEST_CASE("soft pwm rejects pins without port", "[soft_pwm_writer]") {
+    arduinoMockInit();
+    JLedSoftPwm pwm;
+
+    REQUIRE(digitalPinToPort(ARDUINO_PINS) == NOT_A_PORT);
+    REQUIRE(pwm.Attach(ARDUINO_PINS) == int{JLedSoftPwm::kNoChannel});
+    REQUIRE(pwm.num_channels() == 0);
+    REQUIRE(pwm.num_ports() == 0);
+    REQUIRE(SoftPwmWriter(pwm, ARDUINO_PINS).chan() ==
+            int{JLedSoftPwm::kNoChannel});
+}
+
+TEST_CASE("soft pwm channels are released by the last writer",
+          "[soft_pwm_writer]") {
+    arduinoMockInit();
+    JLedSoftPwm pwm;
+    pwm_ = &pwm;
+
+    // more LEDs than channels, created one after the other
+    for (auto i = 0; i < 2 * JLedSoftPwm::kMaxChannels; i++) {
+        auto led = TJLed<SoftPwmWriter>(SoftPwmWriter(pwm, 1)).On();
+        led.Update(0);
+        REQUIRE(pwm.num_channels() == 1);
+    }
+    REQUIRE(pwm.num_channels() == 0);
+
+    {
+        auto writer = SoftPwmWriter(pwm, 9);
+        auto copy = writer;
+        REQUIRE(pwm.refs(writer.chan()) == 2);
+        copy = SoftPwmWriter(pwm, 2);
+        REQUIRE(pwm.refs(writer.chan()) == 1);
+        REQUIRE(pwm.num_channels() == 2);
+
+        writer.analogWrite(255);
+        arduinoMockRunTimer(Isr, 255);
+        REQUIRE(arduinoMockGetPortPinState(9));
+    }
+    // released pins are turned off and no longer driven
+    REQUIRE(pwm.num_channels() == 0);
+    REQUIRE_FALSE(arduinoMockGetPortPinState(9));
+    *portOutputRegister(digitalPinToPort(9)) |= digitalPinToBitMask(9);
+    arduinoMockRunTimer(Isr, 255);
+    REQUIRE(arduinoMockGetPortPinState(9));
+
+    // the 2 ports no longer used are reused for pins on other ports
+    REQUIRE(pwm.Attach(17) >= 0);
+    REQUIRE(pwm.Attach(25) >= 0);
+    REQUIRE(pwm.Attach(9) >= 0);
+    REQUIRE(pwm.num_ports() == int{JLedSoftPwm::kMaxPorts});
+    REQUIRE(pwm.Attach(1) == int{JLedSoftPwm::kNoChannel});
+}
+
+TEST_CASE("soft pwm outputs duty cycle using BAM", "[soft_pwm_writer]") {
+    arduinoMockInit();
+    JLedSoftPwm pwm;
+    pwm_ = &pwm;
+
+    const std::vector<std::pair<uint8_t, uint8_t>> pins_duty = {
+        {1, 0}, {2, 1}, {3, 128}, {9, 85}, {10, 254}, {17, 255}};
+    for (const auto& pd : pins_duty) {
+        pwm.Set(pwm.Attach(pd.first), pd.second);
+    }
+    // pins not attached are not changed
+    *portOutputRegister(digitalPinToPort(4)) |= digitalPinToBitMask(4);
+
+    constexpr auto kPeriods = 10;
+    const auto stats = arduinoMockRunTimer(Isr, kPeriods * 255);
+    REQUIRE(stats.isr_calls == kPeriods * 8);
+    for (const auto& pd : pins_duty) {
+        REQUIRE(arduinoMockGetPinHighTicks(pd.first) == kPeriods * pd.second);
+    }
+    REQUIRE(arduinoMockGetPinHighTicks(4) == kPeriods * 255);
+}
+
+TEST_CASE("TJLed drives soft pwm channel", "[soft_pwm_writer]") {
+    arduinoMockInit();
+    JLedSoftPwm pwm;
+    pwm_ = &pwm;
+    auto led = TJLed<SoftPwmWriter>(SoftPwmWriter(pwm, 5)).Blink(10, 10);
+
+    led.Update(0);
+    arduinoMockRunTimer(Isr, 255);
+    REQUIRE(arduinoMockGetPinHighTicks(5) == 255);
+    led.Update(10);
+    arduinoMockRunTimer(Isr, 255);
+    REQUIRE(arduinoMockGetPinHighTicks(5) == 255);
+}
+
+TEST_CASE("soft pwm ISR cost does not grow with channels",
+          "[soft_pwm_writer]") {
+    // the ISR writes each port once per call, so the number of ISR calls per
+    // period is constant and the ISR time only depends on the number of ports.
+    for (auto n : {1, 2, 4, 8, 16}) {
+        arduinoMockInit();
+        JLedSoftPwm pwm;
+        pwm_ = &pwm;
+        for (auto i = 0; i < n; i++) pwm.Set(pwm.Attach(i), i * 16);
+
+        constexpr auto kPeriods = 1000;
+        const auto stats = arduinoMockRunTimer(Isr, kPeriods * 255);
+        REQUIRE(stats.isr_calls == kPeriods * 8);
+        WARN("soft pwm with " << n << " channel(s) on " << int(pwm.num_ports())
+                              << " port(s): " << stats.ns_per_isr_call
+                              << " ns per ISR call, "
+                              << stats.ns_per_isr_call / n
+                              << " ns per ISR call and channel");
+        for (auto i = 0; i < n; i++) {
+            REQUIRE(arduinoMockGetPinHighTicks(i) == kPeriods * i * 16);
+        }
+    }
+}
@@ -0,0 +1,92 @@
+// JLed Unit tests  (run on host).
+// Copyright 2017 Jan Delgado jdelgado@gmx.net
+#define CATCH_CONFIG_MAIN
+#include "catch.hpp"
+#include <jled.h>            // NOLINT
+#include <tlc5947_writer.h>  // NOLINT
+
+constexpr auto kLatchPin = 10;
+
+// 12 bit word w of the last SPI transaction, unpacked bit by bit, MSB first.
+static uint16_t ShiftedWord(int w) {
+    uint16_t word = 0;
+    for (auto i = 12 * w; i < 12 * (w + 1); i++) {
+        const auto bit = (spiMockGetTransactionByte(i / 8) >> (7 - i % 8)) & 1;
+        word = (word << 1) | bit;
+    }
+    return word;
+}
+
+TEST_CASE("Begin() initializes SPI and switches outputs off",
+          "[tlc5947_writer]") {
+    arduinoMockInit();
+    spiMockInit();
+    JLedTlc5947T<2> tlc(kLatchPin, 4000000);
+    tlc.Begin();
+
+    REQUIRE(arduinoMockGetPinMode(kLatchPin) == OUTPUT);
+    REQUIRE(spiMockIsInitialized());
+    REQUIRE(spiMockGetSettings().clock == 4000000);
+    REQUIRE(spiMockGetSettings().bit_order == MSBFIRST);
+    REQUIRE(spiMockGetTransactionCount() == 1);
+    REQUIRE(spiMockGetTransactionSize() == 2 * 36);
+    for (auto i = 0; i < 2 * 36; i++) {
+        REQUIRE(spiMockGetTransactionByte(i) == 0);
+    }
+    REQUIRE(arduinoMockGetRisingEdgeCount(kLatchPin) == 1);
+    REQUIRE(arduinoMockGetPinState(kLatchPin) == LOW);
+}
+
+TEST_CASE("frame contains 12 bit words, last channel first",
+          "[tlc5947_writer]") {
+    arduinoMockInit();
+    spiMockInit();
+    JLedTlc5947T<2> tlc(kLatchPin);
+    constexpr auto kNumChannels = JLedTlc5947Bus<2>::kNumChannels;
+    static_assert(kNumChannels == 48, "");
+
+    for (auto i = 0; i < kNumChannels; i++) {
+        Tlc5947Writer<2>(tlc, i).analogWrite16(i * 1361);
+    }
+    REQUIRE(tlc.Commit());
+    REQUIRE(spiMockGetTransactionSize() == 2 * 36);
+    for (auto w = 0; w < kNumChannels; w++) {
+        const auto chan = kNumChannels - 1 - w;
+        REQUIRE(ShiftedWord(w) == (uint16_t(chan * 1361) >> 4));
+    }
+
+    // changing a single channel keeps the others
+    Tlc5947Writer<2>(tlc, 6).analogWrite(255);
+    Tlc5947Writer<2>(tlc, 7).analogWrite(0);
+    REQUIRE(tlc.Commit());
+    REQUIRE(ShiftedWord(kNumChannels - 1 - 5) == (5 * 1361) >> 4);
+    REQUIRE(ShiftedWord(kNumChannels - 1 - 6) == 0xfff);
+    REQUIRE(ShiftedWord(kNumChannels - 1 - 7) == 0);
+    REQUIRE(ShiftedWord(kNumChannels - 1 - 8) == (8 * 1361) >> 4);
+}
+
+TEST_CASE("frame is sent and latched once per update pass",
+          "[tlc5947_writer]") {
+    arduinoMockInit();
+    spiMockInit();
+    JLedTlc5947 tlc(kLatchPin);
+    using Tlc5947JLed = TJLed<Tlc5947Writer<1>>;
+    Tlc5947JLed leds[] = {
+        Tlc5947JLed(Tlc5947Writer<1>(tlc, 0)).Blink(10, 10).Forever(),
+        Tlc5947JLed(Tlc5947Writer<1>(tlc, 1)).Blink(10, 10).Forever(),
+        Tlc5947JLed(Tlc5947Writer<1>(tlc, 23)).On()};
+    tlc.Begin();
+
+    auto frames = 1;  // sent by Begin()
+    for (uint32_t t = 0; t < 40; t++) {
+        UpdateAll(leds, 3, t);
+        tlc.Commit();
+        // the LEDs change at t=0, 10, 20, 30
+        if (t % 10 == 0) frames++;
+        REQUIRE(spiMockGetTransactionCount() == frames);
+        REQUIRE(arduinoMockGetRisingEdgeCount(kLatchPin) == frames);
+        REQUIRE_FALSE(spiMockInTransaction());
+    }
+    REQUIRE(ShiftedWord(0) == 0xfff);  // channel 23
+    REQUIRE(ShiftedWord(22) == 0);     // channel 1, off in 2nd half of blink
+}